@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Appends bit fields, most significant bit first, to a byte vector. Bits collect in a 64-bit
+// accumulator and leave it 32 at a time, so there is one store per word rather than per bit.
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    // Appends the low `length` bits of `bits` (length <= 32, bits above it zero)
+    void put(uint32_t bits, int length) {
+        acc_ = (acc_ << length) | bits;
+        pending_ += length;
+        if (pending_ >= 32) {
+            pending_ -= 32;
+            uint32_t word = static_cast<uint32_t>(acc_ >> pending_);
+            std::size_t n = out_.size();
+            out_.resize(n + 4);
+            out_[n] = static_cast<uint8_t>(word >> 24);
+            out_[n + 1] = static_cast<uint8_t>(word >> 16);
+            out_[n + 2] = static_cast<uint8_t>(word >> 8);
+            out_[n + 3] = static_cast<uint8_t>(word);
+            written_ += 32;
+        }
+    }
+
+    // Flushes what is left, zero-padded to a whole byte; returns the number of bits put
+    uint64_t finish() {
+        uint64_t total = written_ + pending_;
+        for (; pending_ > 0; pending_ -= 8) {
+            int shift = pending_ - 8;
+            out_.push_back(static_cast<uint8_t>(shift >= 0 ? acc_ >> shift : acc_ << -shift));
+        }
+        pending_ = 0;
+        written_ = total;
+        return total;
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t acc_ = 0;   // the low `pending_` bits are not yet stored
+    int pending_ = 0;
+    uint64_t written_ = 0;
+};
+
+// Reads bit fields, most significant bit first, from a byte buffer through a 64-bit accumulator
+// refilled up to 8 bytes at a time. Reads past the end see zero bits; callers compare
+// position() with the real stream length.
+class BitReader {
+public:
+    BitReader() = default;
+    BitReader(const uint8_t* data, std::size_t size) : data_(data), size_(size) {}
+
+    // The next n bits (1 <= n <= 32) without consuming them
+    uint32_t peek(int n) {
+        if (count_ < n) refill();
+        return peekFilled(n);
+    }
+    // Same without the refill check, for callers that have consumed at most 56 - n bits since
+    // their last refill()
+    uint32_t peekFilled(int n) const { return static_cast<uint32_t>(acc_ >> (64 - n)); }
+
+    // Consumes n bits (n <= the last peek)
+    void skip(int n) {
+        acc_ <<= n;
+        count_ -= n;
+    }
+
+    // Bits consumed so far: everything loaded minus what is still in the accumulator
+    uint64_t position() const { return static_cast<uint64_t>(pos_) * 8 - count_; }
+
+    // Tops the accumulator up to at least 56 valid bits. The fast path loads 8 bytes but only
+    // counts the whole bytes that fit; the extra bits are the same ones the next load ORs in.
+    void refill() {
+        if (pos_ + 8 <= size_) {
+            uint64_t v = 0;
+            for (int k = 0; k < 8; ++k)
+                v = (v << 8) | data_[pos_ + k];
+            acc_ |= v >> count_;
+            int bytes = (63 - count_) >> 3;
+            pos_ += bytes;
+            count_ += bytes * 8;
+            return;
+        }
+        for (; count_ <= 56; count_ += 8, ++pos_)
+            acc_ |= static_cast<uint64_t>(pos_ < size_ ? data_[pos_] : 0) << (56 - count_);
+    }
+
+private:
+    const uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t pos_ = 0;  // next byte to load
+    uint64_t acc_ = 0;     // valid bits are the top `count_`
+    int count_ = 0;
+};
@@ -1,18 +1,141 @@
 #pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
 #include <vector>
+#include "plane.hpp"
+
+class ThreadPool;
+
+// How the db4 filter bank is evaluated
+enum class DwtMethod {
+    Convolution,  // 4-tap h[]/g[] convolution with symmetric padding (original path)
+    Lifting       // split / predict / update / scale lifting steps with periodic extension, in place
+};
+
+// Instruction set the DWT row/column kernels were compiled for ("AVX2", "SSE2" or "scalar")
+const char* dwtKernelIsa();
 
 // 1D DWT and inverse DWT
-void dwt1D(const std::vector<float>& input, std::vector<float>& approx, std::vector<float>& detail);
-std::vector<float> idwt1D(const std::vector<float>& approx, const std::vector<float>& detail);
-
-// 2D DWT and inverse DWT
-void dwt2D_db4(const std::vector<std::vector<float>>& input,
-               std::vector<std::vector<float>>& LL,
-               std::vector<std::vector<float>>& LH,
-               std::vector<std::vector<float>>& HL,
-               std::vector<std::vector<float>>& HH);
-
-std::vector<std::vector<float>> idwt2D_db4(const std::vector<std::vector<float>>& LL,
-                                           const std::vector<std::vector<float>>& LH,
-                                           const std::vector<std::vector<float>>& HL,
-                                           const std::vector<std::vector<float>>& HH);
\ No newline at end of file
+void dwt1D(const std::vector<float>& input, std::vector<float>& approx, std::vector<float>& detail,
+           DwtMethod method = DwtMethod::Convolution);
+std::vector<float> idwt1D(const std::vector<float>& approx, const std::vector<float>& detail,
+                          DwtMethod method = DwtMethod::Convolution);
+
+// 2D DWT and inverse DWT.
+// With a pool, the row pass is split into horizontal strips and the column pass into
+// column tiles across its threads; the result is bit-identical to the single-threaded one.
+void dwt2D_db4(PlaneView<const float> input,
+               Plane<float>& LL,
+               Plane<float>& LH,
+               Plane<float>& HL,
+               Plane<float>& HH,
+               DwtMethod method = DwtMethod::Convolution,
+               ThreadPool* pool = nullptr);
+
+Plane<float> idwt2D_db4(PlaneView<const float> LL,
+                        PlaneView<const float> LH,
+                        PlaneView<const float> HL,
+                        PlaneView<const float> HH,
+                        DwtMethod method = DwtMethod::Convolution,
+                        ThreadPool* pool = nullptr);
+
+// Subbands of one decomposition level, named as in dwt2D_db4 (LH = horizontal detail)
+enum class Subband { LL, LH, HL, HH };
+
+// Multi-level 2D DWT (Mallat pyramid) computed in place in one buffer.
+// Level l (1 = finest) transforms the top-left pyramidExtent(rows, l-1) x pyramidExtent(cols, l-1)
+// block and leaves it as [LL | LH ; HL | HH]; only LL is decomposed further. Scratch is one
+// row and one narrow column tile per thread, so peak memory stays near 1x the image.
+// Any size works as long as every level is at least 4x4: an odd length is transformed as
+// its even part, and the last sample is carried into the end of the low band (scaled by
+// the low-pass DC gain), so the low half gets the extra sample. Periodic extension has no
+// critically sampled form for an odd length, so the carry is what keeps reconstruction exact
+// without padding; the trade-off is that the carried sample is not filtered. It sits at the
+// right level in LL but is a point sample rather than a low-pass average, so an approximation
+// (quicklook) shows the last row/column of an odd level slightly sharper and noisier, and its
+// quantization error is not spread over neighbours. Even sizes have no carry.
+// Each call sets up a temporary DwtPlan (dwt_plan.hpp); keep a plan to transform many bands.
+bool dwtPyramid(PlaneView<float> image, int levels,
+                DwtMethod method = DwtMethod::Lifting, ThreadPool* pool = nullptr);
+
+// Inverse of dwtPyramid, reconstructing the image in place from the same buffer
+bool idwtPyramid(PlaneView<float> coeffs, int levels,
+                 DwtMethod method = DwtMethod::Lifting, ThreadPool* pool = nullptr);
+
+// Filter banks available to the compile-time templated transform (see filter_bank.hpp).
+// DbN follows the repo's naming by tap count: Db4 is the 4-tap filter of dwt2D_db4.
+enum class Wavelet { Db2, Db4, Db6, Db8, Db10, Db12, Db14, Db16, Db18, Db20, Cdf97, LeGall53 };
+
+const char* waveletName(Wavelet wavelet);                      // "db4", "cdf97", "legall53", ...
+bool parseWavelet(const std::string& name, Wavelet& wavelet);  // inverse of waveletName
+
+// dwtPyramid / idwtPyramid with any Wavelet (periodic extension, same in-place layout).
+// The bank is picked at run time; each one is a separate instantiation with constexpr taps.
+bool dwtPyramid(PlaneView<float> image, int levels, Wavelet wavelet, ThreadPool* pool = nullptr);
+bool idwtPyramid(PlaneView<float> coeffs, int levels, Wavelet wavelet, ThreadPool* pool = nullptr);
+
+// Reversible LeGall 5/3 integer pyramid for lossless coding: same layout and shape rules as
+// dwtPyramid (an odd last sample is carried unscaled, the integer low-pass has unit DC gain),
+// but integer to integer, so idwtPyramid53(dwtPyramid53(x)) == x exactly.
+// Coefficients grow by at most a few bits per level, far from int32 overflow for sensor data.
+// One-shot wrappers around Dwt53Plan (dwt_plan.hpp), which keeps its scratch for reuse.
+bool dwtPyramid53(PlaneView<int32_t> image, int levels, ThreadPool* pool = nullptr);
+bool idwtPyramid53(PlaneView<int32_t> coeffs, int levels, ThreadPool* pool = nullptr);
+
+// Length of the low band after `level` halvings of n (the low half keeps an odd sample, carried
+// unfiltered as described at dwtPyramid; sizes divisible by 2^levels never carry one)
+inline int pyramidExtent(int n, int level) {
+    for (int l = 0; l < level; ++l)
+        n = (n + 1) / 2;
+    return n;
+}
+
+// View of one subband of `level` inside a pyramid buffer (LL only exists at level == levels).
+// Low bands are ceil(n / 2) long and high bands floor(n / 2) along each axis.
+template <typename T>
+PlaneView<T> pyramidSubband(PlaneView<T> coeffs, int level, Subband band) {
+    int h = pyramidExtent(coeffs.rows(), level - 1), w = pyramidExtent(coeffs.cols(), level - 1);
+    int lowH = (h + 1) / 2, lowW = (w + 1) / 2;
+    switch (band) {
+        case Subband::LL: return coeffs.sub(0, 0, lowH, lowW);
+        case Subband::LH: return coeffs.sub(0, lowW, lowH, w - lowW);
+        case Subband::HL: return coeffs.sub(lowH, 0, h - lowH, lowW);
+        default:          return coeffs.sub(lowH, lowW, h - lowH, w - lowW);
+    }
+}
+
+// Order in which subbands are coded: LL of the coarsest level, then LH/HL/HH from level `levels` down to 1
+std::vector<std::pair<int, Subband>> pyramidCodingOrder(int levels);
+// Coefficient count of each subband of a rows x cols pyramid, in pyramidCodingOrder
+std::vector<size_t> pyramidCodingSizes(int rows, int cols, int levels);
+
+// Spectral DWT of a hyperspectral cube (one plane per band, all the same size), in place.
+// Every pixel's spectrum gets `levels` db4 levels along the band axis: after level l the
+// first (bands >> l) planes hold the spectral low band, which is decomposed further, and
+// planes [bands >> l, bands >> (l-1)) hold its detail. bands must be divisible by 2^levels
+// with at least 4 bands at every level.
+bool dwtSpectral(std::vector<Plane<float>>& cube, int levels,
+                 DwtMethod method = DwtMethod::Lifting, ThreadPool* pool = nullptr);
+bool idwtSpectral(std::vector<Plane<float>>& cube, int levels,
+                  DwtMethod method = DwtMethod::Lifting, ThreadPool* pool = nullptr);
+
+// Band-interleaved (BIP) copy of planes [first, first + count) of a cube: rows x (cols * count),
+// with pixel (i, j) holding the planes' samples at columns [j * count, (j + 1) * count) of row i
+Plane<float> interleaveBands(const std::vector<Plane<float>>& cube, int first, int count);
+// Same into an existing rows x (cols * count) buffer
+void interleaveBands(const std::vector<Plane<float>>& cube, int first, int count, PlaneView<float> bip);
+// Inverse of interleaveBands: writes a BIP buffer of `count` bands back into planes [first, first + count)
+void deinterleaveBands(PlaneView<const float> bip, int count, std::vector<Plane<float>>& cube, int first);
+
+// Planes dwt3D transforms together in band-interleaved layout (see DwtPlan's bands). Four
+// converts to and from planes with whole-vector shuffles, which the wider batches lack.
+constexpr int kBipBatch = 4;
+
+// 3D DWT: the spectral DWT followed by a spatial dwtPyramid on every resulting plane. With
+// lifting the spatial pass runs kBipBatch planes at a time through a band-interleaved DwtPlan
+// (same result as plane by plane, bit for bit); convolution goes plane by plane.
+bool dwt3D(std::vector<Plane<float>>& cube, int spectralLevels, int spatialLevels,
+           DwtMethod method = DwtMethod::Lifting, ThreadPool* pool = nullptr);
+bool idwt3D(std::vector<Plane<float>>& cube, int spectralLevels, int spatialLevels,
+            DwtMethod method = DwtMethod::Lifting, ThreadPool* pool = nullptr);
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include "plane.hpp"
+
+class ThreadPool;
+
+// Building blocks shared by the db4 transforms (dwt_db4.cpp, the streaming DWT, ...).
+// Row kernels work on n contiguous floats and are vectorized with simd.hpp.
+namespace dwt_kernels {
+
+// Column tile width (floats) for the vertical passes; keeps the rows of a tile in L1/L2
+constexpr int kColumnTile = 512;
+
+// Column tile width for the in-place pyramid, which copies each tile to scratch first
+constexpr int kInPlaceTile = 64;
+
+// Runs fn(i) for i in [0, count), across the pool when there is one
+void forEachPart(ThreadPool* pool, int count, const std::function<void(int)>& fn);
+
+// Number of horizontal strips the row pass is cut into (a few per thread for load balance)
+int rowStripCount(int rows, ThreadPool* pool);
+
+// Column tile width for the vertical passes: enough tiles to feed every thread,
+// each a whole number of cache lines so neighbouring tiles never share one
+int columnTileWidth(int cols, ThreadPool* pool);
+
+// Checks that every level of a `levels`-deep pyramid on rows x cols (see pyramidExtent) is at least 4x4
+bool pyramidShapeOk(int rows, int cols, int levels);
+
+// Daubechies-4 analysis low-pass / high-pass taps
+extern const float kDb4Low[4];
+extern const float kDb4High[4];
+
+// Whole-sample symmetric extension of index m into [0, N)
+int mirrorIndex(int m, int N);
+
+// Element-wise row kernels
+void scaleRow(float* y, const float* x, float c, int n);                                   // y = c*x
+void addScaledRow(float* y, const float* x, float c, int n);                               // y += c*x
+void addScaled2Row(float* y, const float* x0, const float* x1, float c0, float c1, int n); // y += c0*x0 + c1*x1
+void combine2Row(float* y, const float* x0, const float* x1, float c0, float c1, int n);   // y = c0*x0 + c1*x1
+void combine4Row(float* y, const float* x0, const float* x1, const float* x2, const float* x3,
+                 const float* c, int n);                                                   // y = sum c[t]*xt
+void splitRow(const float* x, float* even, float* odd, int M);   // deinterleave 2M floats
+void mergeRow(const float* even, const float* odd, float* x, int M);  // interleave into 2M floats
+
+// Horizontal db4 on one row. Forward: N inputs -> N/2 lo + N/2 hi; inverse: M + M -> 2M.
+// Scratch: convRowForward even/odd N/2 + 1 floats, liftRowForward odd N/2, inverses M each.
+void convRowForward(const float* x, int N, float* lo, float* hi, float* even, float* odd);
+void convRowInverse(const float* lo, const float* hi, int M, float* out, float* even, float* odd);
+void liftRowForward(const float* x, int N, float* lo, float* hi, float* odd);
+void liftRowInverse(const float* lo, const float* hi, int M, float* out, float* even, float* odd);
+
+// Horizontal db4 lifting of one band-interleaved (BIP) row: N pixels (N even) of B samples,
+// every band filtered in a single sweep with the SIMD lanes running across the bands.
+// Same arithmetic as liftRowForward / liftRowInverse applied band by band.
+void liftInterleavedForward(const float* x, int N, int B, float* lo, float* hi);
+void liftInterleavedInverse(const float* lo, const float* hi, int M, int B, float* out);
+
+// Vertical db4 down every column of a view (adjacent columns share the SIMD lanes)
+void convColumnsForward(PlaneView<const float> in, PlaneView<float> lo, PlaneView<float> hi);
+void convColumnsInverse(PlaneView<const float> lo, PlaneView<const float> hi, PlaneView<float> out);
+void liftColumnsForward(PlaneView<float> p, PlaneView<float> lo, PlaneView<float> hi);  // p is clobbered
+void liftColumnsInverse(PlaneView<const float> lo, PlaneView<const float> hi, PlaneView<float> p);
+
+// Reversible LeGall 5/3 integer lifting (JPEG 2000), symmetric extension, exact in int32.
+// Predict: d[k] = x[2k+1] - ((x[2k] + x[2k+2]) >> 1); update: s[k] = x[2k] + ((d[k-1] + d[k] + 2) >> 2).
+void predict53Row(int32_t* y, const int32_t* x, const int32_t* a, const int32_t* b, int n);    // y = x - ((a+b)>>1)
+void unpredict53Row(int32_t* y, const int32_t* x, const int32_t* a, const int32_t* b, int n);  // y = x + ((a+b)>>1)
+void update53Row(int32_t* y, const int32_t* x, const int32_t* a, const int32_t* b, int n);     // y = x + ((a+b+2)>>2)
+void unupdate53Row(int32_t* y, const int32_t* x, const int32_t* a, const int32_t* b, int n);   // y = x - ((a+b+2)>>2)
+
+// Horizontal 5/3 on one row: N (even) inputs -> N/2 lo + N/2 hi, and back. Scratch: M ints each.
+void lift53RowForward(const int32_t* x, int N, int32_t* lo, int32_t* hi, int32_t* even, int32_t* odd);
+void lift53RowInverse(const int32_t* lo, const int32_t* hi, int M, int32_t* out, int32_t* even, int32_t* odd);
+
+// Vertical 5/3 down every column of a view
+void lift53ColumnsForward(PlaneView<const int32_t> in, PlaneView<int32_t> lo, PlaneView<int32_t> hi);
+void lift53ColumnsInverse(PlaneView<const int32_t> lo, PlaneView<const int32_t> hi, PlaneView<int32_t> out);
+
+}  // namespace dwt_kernels
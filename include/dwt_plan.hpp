@@ -0,0 +1,195 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "dwt_db4.hpp"
+
+struct DwtKernelSet;
+
+// How inverseDequantized8 turns reconstructed samples into pixels
+enum class PixelMapping {
+    Clamp,     // round and clamp to [0, 255]
+    Normalize  // stretch the reconstruction's [min, max] to [0, 255]
+};
+
+// Multi-level pyramid DWT prepared once for a fixed shape, depth and filter.
+// The plan owns all scratch (one row line and one column tile per thread), so forward()
+// and inverse() do no heap allocation; build one per band size and reuse it for every band.
+// A plan runs one transform at a time. dwtPyramid/idwtPyramid are one-shot wrappers.
+//
+// With bands > 1 the plan transforms `bands` images at once in band-interleaved (BIP) layout:
+// a rows x (cols * bands) buffer whose pixel (i, j) holds every band's sample at
+// [j * bands, (j + 1) * bands) of row i (see interleaveBands). Each band is transformed
+// exactly as on its own, but the SIMD lanes sweep across the bands of a pixel in both passes,
+// so rows need no even/odd shuffles. Only forward() and inverse() take BIP data.
+class DwtPlan {
+public:
+    DwtPlan(int rows, int cols, int levels, DwtMethod method = DwtMethod::Lifting, ThreadPool* pool = nullptr,
+            int bands = 1);
+    DwtPlan(int rows, int cols, int levels, Wavelet wavelet, ThreadPool* pool = nullptr, int bands = 1);
+
+    // False when rows x cols cannot take `levels` levels (the reason has been printed)
+    bool valid() const { return valid_; }
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int levels() const { return levels_; }
+    int bands() const { return bands_; }
+
+    // In-place DWT / inverse DWT of a rows x (cols * bands) buffer, laid out as in dwtPyramid
+    bool forward(PlaneView<float> image);
+    bool inverse(PlaneView<float> coeffs);
+
+    // forward() fused with quantization and flattening: as each column tile of a subband
+    // becomes final it is divided by the subband's step, rounded and written straight into
+    // `symbols` (rows x cols ints) in pyramidCodingOrder, row by row within each subband.
+    // `steps` holds one qstep per subband in the same coding order. The float coefficients
+    // are still left in `image`.
+    bool forwardQuantized(PlaneView<float> image, const float* steps, int* symbols);
+
+    // Inverse of forwardQuantized: symbols are multiplied by their step while being loaded
+    // into each level's first (column) stage, so no dequantized pyramid is ever built.
+    // `out` (rows x cols) receives the reconstruction; its prior contents are ignored.
+    bool inverseDequantized(const int* symbols, const float* steps, PlaneView<float> out);
+
+    // Same, but the last row stage writes 8-bit pixels. With Clamp, pixels are produced
+    // straight from the filter output; Normalize needs the range first, so it takes one
+    // extra mapping pass. `work` (rows x cols) holds the intermediate levels.
+    bool inverseDequantized8(const int* symbols, const float* steps, PlaneView<float> work,
+                             PlaneView<uint8_t> out, PixelMapping mapping);
+
+    // Progressive decode: stops `level` levels short of the full image (0 <= level <= levels)
+    // and returns that level's LL approximation, pyramidExtent(rows, level) x
+    // pyramidExtent(cols, level), divided by its DC gain (2 per level) so it keeps the image's
+    // value range. Only the leading approximationSymbols(level) symbols are read, because
+    // coding order puts every subband of the coarser levels first.
+    bool inverseApproximation(const int* symbols, const float* steps, int level, PlaneView<float> out);
+    std::size_t approximationSymbols(int level) const;
+
+    // Reconstructs only the window [r0, r0 + out.rows()) x [c0, c0 + out.cols()) of the image.
+    // Working from level 1 up, each level keeps just the coefficients whose synthesis filters
+    // reach the window (wrapping periodically at the borders); only those are read and inverted,
+    // so the cost follows the window size rather than the scene. Needs a periodic filter
+    // (lifting or a Wavelet). Unlike forward()/inverse() it allocates its window-sized buffers.
+    // `coefficientsRead`, if given, receives the number of pyramid coefficients used.
+    bool inverseRegion(PlaneView<const float> coeffs, int r0, int c0, PlaneView<float> out,
+                       long long* coefficientsRead = nullptr);
+
+    // Same, reading the quantized symbols of forwardQuantized and dequantizing only those used
+    bool inverseRegionDequantized(const int* symbols, const float* steps, int r0, int c0,
+                                  PlaneView<float> out, long long* coefficientsRead = nullptr);
+
+private:
+    struct Slot {
+        std::vector<float> line;     // copy of the row being transformed
+        std::vector<float> scratch;  // row kernel scratch
+        Plane<float> tile;           // column tile copy, rows x kInPlaceTile
+        std::vector<float> result;   // final row before conversion to pixels
+        float minV = 0.0f, maxV = 0.0f;
+    };
+
+    // Outputs [out0, out1) along one axis of a region level, inverted from the `count`
+    // coefficients starting at k0 (taken modulo the band length); a carry span is the odd
+    // last sample, copied from the end of the low band
+    struct RegionSpan {
+        int out0, out1, k0, count;
+        bool carry;
+    };
+    struct RegionAxis {
+        std::vector<RegionSpan> spans;
+        std::vector<int> low, high;  // sorted coefficient indices the spans read
+    };
+
+    // Reads one subband during inverseRegion*, from coefficients or from dequantized symbols
+    struct RegionBand {
+        const float* coeffs;
+        std::ptrdiff_t stride;
+        const int* symbols;
+        float step;
+        float at(int i, int j) const { return coeffs ? coeffs[i * stride + j] : symbols[i * stride + j] * step; }
+    };
+
+    void init(int rows, int cols, int levels, int bands, const DwtKernelSet* kernels, ThreadPool* pool);
+    bool shapeMatches(PlaneView<float> p) const;
+    bool singleBand() const;
+    void rowsForward(int slot);
+    void rowsInverse(int slot);
+    void columnsForward(int slot);
+    void columnsInverse(int slot);
+    void emitSymbols(int c0, int tw);
+    void loadTile(PlaneView<float> tile, int c0, int tw);
+    void mapPixels(int slot);
+    bool runInverse(PlaneView<float> coeffs, int stopLevel = 0);
+    RegionAxis planRegionAxis(const std::vector<int>& wanted, int n) const;
+    RegionBand regionBand(int level, Subband band) const;
+    bool runRegion(int r0, int c0, PlaneView<float> out, long long* coefficientsRead);
+
+    const DwtKernelSet* kernels_ = nullptr;
+    ThreadPool* pool_ = nullptr;
+    int rows_ = 0;
+    int cols_ = 0;
+    int levels_ = 0;
+    int bands_ = 1;
+    bool valid_ = false;
+    std::vector<Slot> slots_;
+
+    // Level currently being transformed and its column tiling
+    PlaneView<float> block_;
+    int tileWidth_ = 0;
+    int level_ = 0;
+
+    // Set only during forwardQuantized: steps and output, plus each subband's position in
+    // coding order, indexed (level - 1) * 4 + band
+    const float* steps_ = nullptr;
+    int* symbols_ = nullptr;
+    const int* inSymbols_ = nullptr;  // inverseDequantized*: symbols to load instead of coefficients
+    PlaneView<uint8_t> pixels_;       // inverseDequantized8: 8-bit output
+    PixelMapping mapping_ = PixelMapping::Clamp;
+    float normalizeMin_ = 0.0f;
+    float normalizeMax_ = 0.0f;
+    PlaneView<const float> regionCoeffs_;  // inverseRegion: pyramid to read from
+    std::vector<int> codingIndex_;
+    std::vector<std::ptrdiff_t> symbolOffset_;
+};
+
+// Reversible 5/3 integer pyramid (see dwtPyramid53) prepared once for a fixed shape and
+// depth. Like DwtPlan it owns one row line and one column tile per thread, so forward()
+// and inverse() do no heap allocation; dwtPyramid53/idwtPyramid53 are one-shot wrappers.
+class Dwt53Plan {
+public:
+    Dwt53Plan(int rows, int cols, int levels, ThreadPool* pool = nullptr);
+
+    // False when rows x cols cannot take `levels` levels (the reason has been printed)
+    bool valid() const { return valid_; }
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int levels() const { return levels_; }
+
+    // In-place 5/3 DWT / inverse DWT of a rows x cols buffer
+    bool forward(PlaneView<int32_t> image);
+    bool inverse(PlaneView<int32_t> coeffs);
+
+private:
+    struct Slot {
+        std::vector<int32_t> line;  // copy of the row being transformed
+        std::vector<int32_t> even;  // row kernel scratch, cols / 2 each
+        std::vector<int32_t> odd;
+        Plane<int32_t> tile;        // column tile copy, rows x kInPlaceTile
+    };
+
+    bool shapeMatches(PlaneView<int32_t> p) const;
+    void setLevel(PlaneView<int32_t> image, int l);
+    void rowsForward(int slot);
+    void rowsInverse(int slot);
+    void columnsForward(int slot);
+    void columnsInverse(int slot);
+
+    ThreadPool* pool_ = nullptr;
+    int rows_ = 0;
+    int cols_ = 0;
+    int levels_ = 0;
+    bool valid_ = false;
+    std::vector<Slot> slots_;
+
+    // Level currently being transformed and its column tiling
+    PlaneView<int32_t> block_;
+    int tileWidth_ = 0;
+};
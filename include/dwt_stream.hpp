@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "dwt_db4.hpp"
+
+// Receives one finished coefficient row: `row` is its index inside subband `band` of `level` (1 = finest)
+using CoefficientRowSink = std::function<void(int level, Subband band, int row, const float* data, int cols)>;
+
+// Line-based multi-level db4 DWT for images streamed one row at a time.
+// Produces the same coefficients as dwtPyramid(..., DwtMethod::Lifting) (to float rounding),
+// but each level only keeps its four most recent rows plus its first two (needed for
+// the periodic wrap at the bottom edge), so memory is O(levels * cols) whatever the
+// image height. Detail rows of every level, and LL rows of the coarsest level, are
+// handed to the sink as soon as they are final.
+class StreamingDwt {
+public:
+    // cols must be divisible by 2^levels with every level at least 4 wide
+    StreamingDwt(int cols, int levels, CoefficientRowSink sink);
+
+    bool valid() const { return !levels_.empty(); }
+
+    // Feeds the next image row (cols floats)
+    void pushRow(const float* row);
+
+    // Flushes the last row of every level; the row count must be divisible by 2^levels (and >= 4 per level)
+    bool finish();
+
+    // Bytes held in row buffers across all levels
+    std::size_t bufferedBytes() const;
+
+private:
+    struct Level {
+        int cols = 0;
+        long long rowsIn = 0;          // rows received at this level
+        std::vector<float> ring;       // last 4 horizontally transformed rows, [L | H] each
+        std::vector<float> first;      // rows 0 and 1, reused for the bottom wrap
+        std::vector<float> lo, hi;     // one output row pair: [LL | LH] and [HL | HH]
+        std::vector<float> scratch;
+    };
+
+    void push(int l, const float* row);
+    void emit(int l, long long k, const float* r0, const float* r1, const float* r2, const float* r3);
+
+    std::vector<Level> levels_;
+    CoefficientRowSink sink_;
+};
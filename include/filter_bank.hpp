@@ -0,0 +1,356 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include "dwt_kernels.hpp"
+#include "simd.hpp"
+
+// Two-channel filter banks with constexpr taps, and DWT kernels templated on them.
+//
+// A bank has analysis taps kLow/kHigh applied with periodic extension,
+//   a[k] = sum_t kLow[t]  x[2k + t + kLowOffset],   d[k] = sum_t kHigh[t] x[2k + t + kHighOffset],
+// and dual taps kSynthLow/kSynthHigh indexed the same way; synthesis is the transpose of the
+// dual analysis, x[n] = sum_k a[k] kSynthLow[n - 2k - kSynthLowOffset] + d[k] kSynthHigh[...].
+// For orthogonal banks the dual is the bank itself. Every low-pass sums to sqrt(2), so one
+// quantization table fits all of them.
+namespace filter_banks {
+
+// Daubechies low-pass taps by tap count (repo naming: db4 = 4 taps, which PyWavelets calls db2)
+template <int N> struct DaubechiesLow;
+template <> struct DaubechiesLow<2> {
+    static constexpr std::array<float, 2> kTaps = {
+        0.7071067811865476f, 0.7071067811865476f
+    };
+};
+template <> struct DaubechiesLow<4> {
+    static constexpr std::array<float, 4> kTaps = {
+        0.4829629131445343f, 0.8365163037378081f, 0.2241438680420133f, -0.1294095225512605f
+    };
+};
+template <> struct DaubechiesLow<6> {
+    static constexpr std::array<float, 6> kTaps = {
+        0.3326705529500827f, 0.8068915093110927f, 0.4598775021184915f, -0.1350110200102546f,
+        -0.08544127388202664f, 0.03522629188570957f
+    };
+};
+template <> struct DaubechiesLow<8> {
+    static constexpr std::array<float, 8> kTaps = {
+        0.2303778133088966f, 0.7148465705529159f, 0.630880767929859f, -0.02798376941685991f,
+        -0.1870348117190931f, 0.03084138183556076f, 0.0328830116668852f, -0.01059740178506904f
+    };
+};
+template <> struct DaubechiesLow<10> {
+    static constexpr std::array<float, 10> kTaps = {
+        0.160102397974193f, 0.6038292697971899f, 0.7243085284377733f, 0.1384281459013202f,
+        -0.2422948870663821f, -0.03224486958463836f, 0.07757149384004577f, -0.006241490212798298f,
+        -0.01258075199908201f, 0.003335725285473777f
+    };
+};
+template <> struct DaubechiesLow<12> {
+    static constexpr std::array<float, 12> kTaps = {
+        0.1115407433501095f, 0.4946238903984533f, 0.7511339080210956f, 0.3152503517091976f,
+        -0.2262646939654401f, -0.1297668675672619f, 0.09750160558732315f, 0.02752286553030572f,
+        -0.03158203931748606f, 0.000553842201161505f, 0.004777257510945514f, -0.001077301085308481f
+    };
+};
+template <> struct DaubechiesLow<14> {
+    static constexpr std::array<float, 14> kTaps = {
+        0.0778520540850091f, 0.396539319481917f, 0.7291320908462348f, 0.4697822874051931f,
+        -0.1439060039285643f, -0.2240361849938748f, 0.07130921926683015f, 0.08061260915108297f,
+        -0.03802993693501432f, -0.01657454163066688f, 0.01255099855609982f, 0.0004295779729213697f,
+        -0.001801640704047488f, 0.0003537137999745192f
+    };
+};
+template <> struct DaubechiesLow<16> {
+    static constexpr std::array<float, 16> kTaps = {
+        0.05441584224310399f, 0.3128715909142999f, 0.6756307362972898f, 0.5853546836542063f,
+        -0.01582910525634847f, -0.2840155429615475f, 0.0004724845739137721f, 0.1287474266204781f,
+        -0.01736930100180731f, -0.0440882539307948f, 0.01398102791739827f, 0.008746094047405771f,
+        -0.004870352993451569f, -0.0003917403733769472f, 0.0006754494064505686f, -0.0001174767841247694f
+    };
+};
+template <> struct DaubechiesLow<18> {
+    static constexpr std::array<float, 18> kTaps = {
+        0.03807794736387834f, 0.2438346746125903f, 0.6048231236901113f, 0.6572880780513006f,
+        0.1331973858250076f, -0.2932737832791757f, -0.09684078322297514f, 0.1485407493381057f,
+        0.03072568147933337f, -0.06763282906132984f, 0.0002509471148314083f, 0.02236166212367907f,
+        -0.004723204757751388f, -0.004281503682463431f, 0.001847646883056226f, 0.0002303857635231962f,
+        -0.0002519631889427103f, 3.934732031627163e-05f
+    };
+};
+template <> struct DaubechiesLow<20> {
+    static constexpr std::array<float, 20> kTaps = {
+        0.02667005790055558f, 0.1881768000776917f, 0.5272011889317259f, 0.6884590394536042f,
+        0.2811723436605761f, -0.2498464243273151f, -0.1959462743773761f, 0.1273693403357911f,
+        0.09305736460357449f, -0.07139414716639832f, -0.02945753682187544f, 0.03321267405934095f,
+        0.003606553566956202f, -0.01073317548333061f, 0.001395351747052915f, 0.001992405295185055f,
+        -0.0006858566949597123f, -0.0001164668551292856f, 9.358867032006974e-05f, -1.326420289452127e-05f
+    };
+};
+
+// g[t] = (-1)^t h[N-1-t]: the orthogonal high-pass matching low-pass h
+template <std::size_t N>
+constexpr std::array<float, N> alternatingFlip(const std::array<float, N>& h) {
+    std::array<float, N> g{};
+    for (std::size_t t = 0; t < N; ++t)
+        g[t] = (t % 2 ? -1.0f : 1.0f) * h[N - 1 - t];
+    return g;
+}
+
+// Orthogonal Daubechies wavelet with N taps (N even, 2..20); Daubechies<4> is the repo's db4
+template <int N>
+struct Daubechies {
+    static constexpr std::array<float, N> kLow = DaubechiesLow<N>::kTaps;
+    static constexpr std::array<float, N> kHigh = alternatingFlip(kLow);
+    static constexpr int kLowOffset = 0;
+    static constexpr int kHighOffset = 0;
+    static constexpr std::array<float, N> kSynthLow = kLow;
+    static constexpr std::array<float, N> kSynthHigh = kHigh;
+    static constexpr int kSynthLowOffset = 0;
+    static constexpr int kSynthHighOffset = 0;
+};
+
+// Cohen-Daubechies-Feauveau 9/7 (the JPEG 2000 irreversible filter), symmetric, centred on 2k / 2k+1
+struct Cdf97 {
+    static constexpr std::array<float, 9> kLow = {
+        0.037828455506995f, -0.02384946501938f, -0.11062440441842f, 0.37740285561265f, 0.8526986790094f,
+        0.37740285561265f, -0.11062440441842f, -0.02384946501938f, 0.037828455506995f
+    };
+    static constexpr std::array<float, 7> kHigh = {
+        0.064538882628938f, -0.040689417609558f, -0.41809227322221f, 0.78848561640566f,
+        -0.41809227322221f, -0.040689417609558f, 0.064538882628938f
+    };
+    static constexpr int kLowOffset = -4;
+    static constexpr int kHighOffset = -2;
+    static constexpr std::array<float, 7> kSynthLow = {
+        -0.064538882628938f, -0.040689417609558f, 0.41809227322221f, 0.78848561640566f,
+        0.41809227322221f, -0.040689417609558f, -0.064538882628938f
+    };
+    static constexpr std::array<float, 9> kSynthHigh = {
+        0.037828455506995f, 0.02384946501938f, -0.11062440441842f, -0.37740285561265f, 0.8526986790094f,
+        -0.37740285561265f, -0.11062440441842f, 0.02384946501938f, 0.037828455506995f
+    };
+    static constexpr int kSynthLowOffset = -3;
+    static constexpr int kSynthHighOffset = -3;
+};
+
+// LeGall 5/3 in floating point (the reversible integer version is dwtPyramid53)
+struct LeGall53 {
+    static constexpr std::array<float, 5> kLow = {
+        -0.1767766952966369f, 0.3535533905932738f, 1.060660171779821f, 0.3535533905932738f, -0.1767766952966369f
+    };
+    static constexpr std::array<float, 3> kHigh = { -0.3535533905932737f, 0.7071067811865475f, -0.3535533905932737f };
+    static constexpr int kLowOffset = -2;
+    static constexpr int kHighOffset = 0;
+    static constexpr std::array<float, 3> kSynthLow = { 0.3535533905932737f, 0.7071067811865475f, 0.3535533905932737f };
+    static constexpr std::array<float, 5> kSynthHigh = {
+        -0.1767766952966369f, -0.3535533905932738f, 1.060660171779821f, -0.3535533905932738f, -0.1767766952966369f
+    };
+    static constexpr int kSynthLowOffset = -1;
+    static constexpr int kSynthHighOffset = -1;
+};
+
+}  // namespace filter_banks
+
+namespace dwt_kernels {
+
+// One output phase of a bank as K taps: out[k] = sum_i coef[i] * source[src[i]][k + shift[i]]
+template <int K>
+struct PhaseTaps {
+    std::array<float, K> coef{};
+    std::array<int, K> src{};
+    std::array<int, K> shift{};
+};
+
+constexpr int floorDiv2(int v) { return v >= 0 ? v / 2 : -((1 - v) / 2); }
+constexpr int parity(int v) { return v - 2 * floorDiv2(v); }
+
+// Analysis filter f over the even (src 0) and odd (src 1) input samples
+template <std::size_t L>
+constexpr PhaseTaps<static_cast<int>(L)> analysisTaps(const std::array<float, L>& f, int offset) {
+    PhaseTaps<static_cast<int>(L)> p;
+    for (int t = 0; t < static_cast<int>(L); ++t) {
+        p.coef[t] = f[t];
+        p.src[t] = parity(t + offset);
+        p.shift[t] = floorDiv2(t + offset);
+    }
+    return p;
+}
+
+// Number of taps of a synthesis filter that land on output phase `phase` (0 = even samples)
+template <std::size_t L>
+constexpr int synthesisCount(const std::array<float, L>&, int offset, int phase) {
+    int n = 0;
+    for (int t = 0; t < static_cast<int>(L); ++t)
+        n += parity(t + offset) == phase;
+    return n;
+}
+
+// Output phase `phase` of the synthesis, from the low (src 0) and high (src 1) bands
+template <int K, std::size_t L0, std::size_t L1>
+constexpr PhaseTaps<K> synthesisTaps(const std::array<float, L0>& low, int lowOffset,
+                                     const std::array<float, L1>& high, int highOffset, int phase) {
+    PhaseTaps<K> p;
+    int i = 0;
+    for (int t = 0; t < static_cast<int>(L0); ++t) {
+        if (parity(t + lowOffset) != phase) continue;
+        p.coef[i] = low[t];
+        p.src[i] = 0;
+        p.shift[i++] = -(t + lowOffset - phase) / 2;
+    }
+    for (int t = 0; t < static_cast<int>(L1); ++t) {
+        if (parity(t + highOffset) != phase) continue;
+        p.coef[i] = high[t];
+        p.src[i] = 1;
+        p.shift[i++] = -(t + highOffset - phase) / 2;
+    }
+    return p;
+}
+
+template <int K>
+constexpr int maxAbsShift(const PhaseTaps<K>& p) {
+    int m = 0;
+    for (int i = 0; i < K; ++i)
+        m = p.shift[i] > m ? p.shift[i] : (-p.shift[i] > m ? -p.shift[i] : m);
+    return m;
+}
+
+// Polyphase form of a bank, all computed at compile time
+template <class FB>
+struct Polyphase {
+    static constexpr auto kLow = analysisTaps(FB::kLow, FB::kLowOffset);
+    static constexpr auto kHigh = analysisTaps(FB::kHigh, FB::kHighOffset);
+    static constexpr int kEvenTaps = synthesisCount(FB::kSynthLow, FB::kSynthLowOffset, 0) +
+                                     synthesisCount(FB::kSynthHigh, FB::kSynthHighOffset, 0);
+    static constexpr int kOddTaps = synthesisCount(FB::kSynthLow, FB::kSynthLowOffset, 1) +
+                                    synthesisCount(FB::kSynthHigh, FB::kSynthHighOffset, 1);
+    static constexpr auto kEven = synthesisTaps<kEvenTaps>(FB::kSynthLow, FB::kSynthLowOffset,
+                                                           FB::kSynthHigh, FB::kSynthHighOffset, 0);
+    static constexpr auto kOdd = synthesisTaps<kOddTaps>(FB::kSynthLow, FB::kSynthLowOffset,
+                                                         FB::kSynthHigh, FB::kSynthHighOffset, 1);
+    // Samples of periodic extension needed on each side of a band
+    static constexpr int kMargin = std::max({ maxAbsShift(kLow), maxAbsShift(kHigh),
+                                              maxAbsShift(kEven), maxAbsShift(kOdd) });
+};
+
+inline int wrapIndex(int i, int M) {
+    i %= M;
+    return i < 0 ? i + M : i;
+}
+
+// y = sum_i c[i] * x[i] over n floats; K is a compile-time constant, so the tap loop unrolls
+template <int K>
+void combineTaps(float* y, const std::array<const float*, K>& x, const std::array<float, K>& c, int n) {
+    simd::Vec vc[K];
+    for (int i = 0; i < K; ++i)
+        vc[i] = simd::set1(c[i]);
+    int j = 0;
+    for (; j + simd::kWidth <= n; j += simd::kWidth) {
+        simd::Vec acc = simd::mul(vc[0], simd::load(x[0] + j));
+        for (int i = 1; i < K; ++i)
+            acc = simd::add(acc, simd::mul(vc[i], simd::load(x[i] + j)));
+        simd::store(y + j, acc);
+    }
+    for (; j < n; ++j) {
+        float acc = c[0] * x[0][j];
+        for (int i = 1; i < K; ++i)
+            acc = acc + c[i] * x[i][j];
+        y[j] = acc;
+    }
+}
+
+// Phase taps over two margin-extended bands: y[k] for k in [0, n)
+template <int K>
+void applyTaps(float* y, const PhaseTaps<K>& taps, const float* const src[2], int n) {
+    std::array<const float*, K> x;
+    for (int i = 0; i < K; ++i)
+        x[i] = src[taps.src[i]] + taps.shift[i];
+    combineTaps<K>(y, x, taps.coef, n);
+}
+
+// Fills `margin` samples of periodic extension on both sides of buf[margin .. margin + M)
+inline void periodicPad(float* buf, int M, int margin) {
+    float* band = buf + margin;
+    for (int i = 1; i <= margin; ++i) {
+        band[-i] = band[wrapIndex(-i, M)];
+        band[M - 1 + i] = band[wrapIndex(M - 1 + i, M)];
+    }
+}
+
+// Scratch floats filterRowForward / filterRowInverse need for M samples per band
+template <class FB>
+constexpr int filterRowScratch(int M) {
+    return 4 * (M + 2 * Polyphase<FB>::kMargin);
+}
+
+// Horizontal analysis of one row (N even): N inputs -> N/2 lo + N/2 hi
+template <class FB>
+void filterRowForward(const float* x, int N, float* lo, float* hi, float* scratch) {
+    using P = Polyphase<FB>;
+    int M = N / 2, ext = M + 2 * P::kMargin;
+    float* even = scratch;
+    float* odd = scratch + ext;
+    splitRow(x, even + P::kMargin, odd + P::kMargin, M);
+    periodicPad(even, M, P::kMargin);
+    periodicPad(odd, M, P::kMargin);
+    const float* src[2] = { even + P::kMargin, odd + P::kMargin };
+    applyTaps(lo, P::kLow, src, M);
+    applyTaps(hi, P::kHigh, src, M);
+}
+
+// Horizontal synthesis of one row: M + M coefficients -> 2M samples
+template <class FB>
+void filterRowInverse(const float* lo, const float* hi, int M, float* out, float* scratch) {
+    using P = Polyphase<FB>;
+    int ext = M + 2 * P::kMargin;
+    float* a = scratch;
+    float* d = scratch + ext;
+    float* even = scratch + 2 * ext;
+    float* odd = even + M;
+    std::copy(lo, lo + M, a + P::kMargin);
+    std::copy(hi, hi + M, d + P::kMargin);
+    periodicPad(a, M, P::kMargin);
+    periodicPad(d, M, P::kMargin);
+    const float* src[2] = { a + P::kMargin, d + P::kMargin };
+    applyTaps(even, P::kEven, src, M);
+    applyTaps(odd, P::kOdd, src, M);
+    mergeRow(even, odd, out, M);
+}
+
+// Vertical analysis down every column of `in` (even rows) into lo/hi (rows/2 each)
+template <class FB>
+void filterColumnsForward(PlaneView<const float> in, PlaneView<float> lo, PlaneView<float> hi) {
+    using P = Polyphase<FB>;
+    int M = in.rows() / 2, W = in.cols();
+    constexpr int KL = static_cast<int>(FB::kLow.size()), KH = static_cast<int>(FB::kHigh.size());
+    std::array<const float*, KL> xl;
+    std::array<const float*, KH> xh;
+    for (int k = 0; k < M; ++k) {
+        for (int i = 0; i < KL; ++i)
+            xl[i] = in.row(2 * wrapIndex(k + P::kLow.shift[i], M) + P::kLow.src[i]);
+        for (int i = 0; i < KH; ++i)
+            xh[i] = in.row(2 * wrapIndex(k + P::kHigh.shift[i], M) + P::kHigh.src[i]);
+        combineTaps<KL>(lo.row(k), xl, P::kLow.coef, W);
+        combineTaps<KH>(hi.row(k), xh, P::kHigh.coef, W);
+    }
+}
+
+// Vertical synthesis down the columns: lo/hi (M rows each) -> out (2M rows)
+template <class FB>
+void filterColumnsInverse(PlaneView<const float> lo, PlaneView<const float> hi, PlaneView<float> out) {
+    using P = Polyphase<FB>;
+    int M = lo.rows(), W = lo.cols();
+    const PlaneView<const float> bands[2] = { lo, hi };
+    std::array<const float*, P::kEvenTaps> xe;
+    std::array<const float*, P::kOddTaps> xo;
+    for (int m = 0; m < M; ++m) {
+        for (int i = 0; i < P::kEvenTaps; ++i)
+            xe[i] = bands[P::kEven.src[i]].row(wrapIndex(m + P::kEven.shift[i], M));
+        for (int i = 0; i < P::kOddTaps; ++i)
+            xo[i] = bands[P::kOdd.src[i]].row(wrapIndex(m + P::kOdd.shift[i], M));
+        combineTaps<P::kEvenTaps>(out.row(2 * m), xe, P::kEven.coef, W);
+        combineTaps<P::kOddTaps>(out.row(2 * m + 1), xo, P::kOdd.coef, W);
+    }
+}
+
+}  // namespace dwt_kernels
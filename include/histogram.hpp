@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Symbol counts over the dense range [minSymbol(), maxSymbol()], one slot per value.
+// count() may be called again on new data; the buffers are kept and reused.
+class Histogram {
+public:
+    // Widest range count() accepts by default, also the widest the Huffman coder's dense code
+    // arrays accept: 128 MB of 64-bit counts, plus up to 256 MB of lane counters in count()
+    static constexpr long long kDefaultMaxRange = 1 << 24;
+
+    // Replaces the contents with the counts of data[0..n). False (after printing why, and with
+    // the histogram left empty) if max - min + 1 exceeds maxRange.
+    bool count(const int* data, size_t n, long long maxRange = kDefaultMaxRange);
+    bool count(const std::vector<int>& data, long long maxRange = kDefaultMaxRange) {
+        return count(data.data(), data.size(), maxRange);
+    }
+
+    // Adds the counts of data[0..n) to the current ones, widening the range as needed (for
+    // data that arrives in pieces, such as streamed rows). False (after printing why, with the
+    // counts unchanged) if the combined range would exceed maxRange.
+    bool add(const int* data, size_t n, long long maxRange = kDefaultMaxRange);
+    // Same with the counts of another histogram, so joined data need not be counted again
+    bool add(const Histogram& other, long long maxRange = kDefaultMaxRange);
+
+    bool empty() const { return counts_.empty(); }
+    int minSymbol() const { return minSymbol_; }
+    int maxSymbol() const { return minSymbol_ + range() - 1; }
+    int range() const { return static_cast<int>(counts_.size()); }
+    uint64_t total() const { return total_; }
+    // Number of values that occur at least once
+    int distinct() const { return distinct_; }
+
+    // Occurrences of symbol (which must lie in [minSymbol(), maxSymbol()])
+    uint64_t operator[](int symbol) const { return counts_[symbol - minSymbol_]; }
+    // counts()[k] is the count of minSymbol() + k
+    const std::vector<uint64_t>& counts() const { return counts_; }
+
+private:
+    bool widen(int minV, int maxV, long long maxRange);
+
+    int minSymbol_ = 0;
+    uint64_t total_ = 0;
+    int distinct_ = 0;
+    std::vector<uint64_t> counts_;
+    std::vector<uint32_t> lanes_;  // interleaved sub-histograms, scratch for count()
+};
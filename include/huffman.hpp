@@ -1,7 +1,168 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <vector>
-#include <string>
-#include <unordered_map>
+#include "bit_io.hpp"
+#include "histogram.hpp"
 
-std::string huffmanEncode(const std::vector<int>& data, std::unordered_map<int, std::string>& huffTable);
-std::vector<int> huffmanDecode(const std::string& encoded, const std::unordered_map<std::string, int>& reverseTable, size_t expectedSymbols);
\ No newline at end of file
+// Prefix code over the symbol range [minSymbol, minSymbol + symbolCount()): symbol s is the low
+// lengths[s - minSymbol] bits of codes[s - minSymbol], sent most significant bit first.
+// Length 0 marks a symbol that does not occur. Codes are canonical, so the lengths alone
+// determine them (see assignCanonicalCodes).
+struct HuffmanCode {
+    int minSymbol = 0;
+    std::vector<uint32_t> codes;
+    std::vector<uint8_t> lengths;
+
+    int symbolCount() const { return static_cast<int>(lengths.size()); }
+    int length(int symbol) const { return lengths[symbol - minSymbol]; }
+};
+
+// Packed bitstream: bitCount bits, starting at the most significant bit of bytes[0],
+// zero-padded to a whole byte
+struct HuffmanBits {
+    std::vector<uint8_t> bytes;
+    uint64_t bitCount = 0;
+};
+
+// Longest code the coder handles (codes are packed into 32-bit words)
+constexpr int kMaxHuffmanLength = 32;
+// Default cap on code lengths: with an 11-bit first lookup every code decodes in at most two
+// table reads, and the second-level blocks are at most 16 entries
+constexpr int kDefaultHuffmanLimit = 15;
+
+// Sets codes from lengths in canonical order: shorter codes first, equal lengths by symbol,
+// each code the previous one plus one. False (after printing why) if the lengths are longer
+// than kMaxHuffmanLength or oversubscribe the code space.
+bool assignCanonicalCodes(HuffmanCode& code);
+
+// Canonical Huffman code of a histogram with no code longer than maxLength bits: the plain
+// Huffman lengths when they fit, otherwise the optimal limited ones (package-merge). A limit
+// too small for the number of distinct symbols is raised to the smallest that fits them.
+// False (after printing why) if the symbol range is too wide.
+bool buildHuffmanCode(const Histogram& hist, HuffmanCode& code, int maxLength = kDefaultHuffmanLimit);
+// Same, counting data first
+bool buildHuffmanCode(const std::vector<int>& data, HuffmanCode& code, int maxLength = kDefaultHuffmanLimit);
+// buildHuffmanCode, then data packed with the code. Pass hist when the caller has already
+// counted data (it must be data's histogram).
+bool huffmanEncode(const std::vector<int>& data, HuffmanCode& code, HuffmanBits& bits,
+                   int maxLength = kDefaultHuffmanLimit);
+bool huffmanEncode(const std::vector<int>& data, const Histogram& hist, HuffmanCode& code, HuffmanBits& bits,
+                   int maxLength = kDefaultHuffmanLimit);
+
+// Table-driven decoder for one code. Codes of up to lookupBits bits resolve with a single
+// lookup on the next lookupBits bits of the stream; longer codes share their first lookupBits
+// bits with a few others and finish in a second table indexed by the bits that follow.
+// Build once per code and reuse it for every stream coded with it.
+class HuffmanDecoder {
+public:
+    static constexpr int kDefaultLookupBits = 11;  // 2K entries, 16 KB: stays in L1
+
+    explicit HuffmanDecoder(const HuffmanCode& code, int lookupBits = kDefaultLookupBits);
+
+    // Decodes up to expectedSymbols symbols; stops early (printing why) on a truncated or invalid stream
+    std::vector<int> decode(const HuffmanBits& bits, size_t expectedSymbols) const;
+    // Decodes the next symbol from a reader positioned on one; false if the bits are no code.
+    // With Refill = false the reader is not topped up: the caller refills it at least once per
+    // 56 bits, i.e. every symbolsPerRefill() symbols.
+    template <bool Refill = true>
+    bool next(BitReader& reader, int& symbol) const {
+        Entry e = table_[Refill ? reader.peek(lookupBits_) : reader.peekFilled(lookupBits_)];
+        if (!e.length && e.subBits) {
+            uint32_t bits = Refill ? reader.peek(lookupBits_ + e.subBits) : reader.peekFilled(lookupBits_ + e.subBits);
+            e = table_[e.value + (bits & ((uint32_t(1) << e.subBits) - 1))];
+        }
+        // An invalid code has length 0: nothing is consumed and the caller sees false
+        reader.skip(e.length);
+        symbol = e.value;
+        return e.length != 0;
+    }
+    // Symbols that are sure to fit in the 56 bits a refill guarantees
+    int symbolsPerRefill() const { return 56 / maxLength_; }
+
+private:
+    // A symbol and its full code length, or (length 0) a link to a second-level block
+    struct Entry {
+        int32_t value = 0;     // symbol, or index of the block's first entry
+        uint8_t length = 0;    // code length in bits; 0: link (subBits > 0) or invalid code
+        uint8_t subBits = 0;   // bits after the first lookupBits that index the linked block
+    };
+
+    int lookupBits_ = 0;
+    int maxLength_ = 1;
+    std::vector<Entry> table_;  // 2^lookupBits primary entries, then the second-level blocks
+};
+
+// One-shot HuffmanDecoder(code).decode(bits, expectedSymbols)
+std::vector<int> huffmanDecode(const HuffmanBits& bits, const HuffmanCode& code, size_t expectedSymbols);
+
+// Bits of a segmented stream (see huffmanEncodeSegments). Symbol i of a segment goes to
+// stream i % streams; every stream is padded to a whole byte and they follow each other,
+// stream by stream within a segment, segment by segment. streamBits is the jump table: the
+// length in bits of each stream, `streams` entries per segment, from which a reader finds
+// where every stream starts.
+struct SegmentedBits {
+    int streams = 1;
+    std::vector<uint8_t> bytes;
+    std::vector<uint64_t> streamBits;
+
+    uint64_t bitCount() const {
+        uint64_t total = 0;
+        for (uint64_t n : streamBits) total += n;
+        return total;
+    }
+};
+
+// Most interleaved streams per segment; 4 keeps four lookups in flight, which is about what
+// the load ports and the table's L1 footprint allow
+constexpr int kMaxHuffmanStreams = 4;
+
+// Per-context coding: data is split into consecutive segments of sizes[s] symbols (in practice
+// the subbands in coding order, whose statistics differ widely) and each segment gets its own
+// code from its own histogram. With streams > 1 each segment is also split into that many
+// interleaved streams, so the decoder can follow several bit positions at once.
+bool huffmanEncodeSegments(const std::vector<int>& data, const std::vector<size_t>& sizes, int streams,
+                           std::vector<HuffmanCode>& codes, SegmentedBits& bits, int maxLength = kDefaultHuffmanLimit);
+// Same with each segment's histogram already counted (see countSegments)
+bool huffmanEncodeSegments(const std::vector<int>& data, const std::vector<size_t>& sizes,
+                           const std::vector<Histogram>& hists, int streams, std::vector<HuffmanCode>& codes,
+                           SegmentedBits& bits, int maxLength = kDefaultHuffmanLimit);
+// One histogram per segment of data; false (after printing why) if sizes do not cover data.
+// Count once and pass them on: merging and coding then never read the data to count it again.
+bool countSegments(const std::vector<int>& data, const std::vector<size_t>& sizes, std::vector<Histogram>& hists);
+// Joins neighbouring segments wherever one table for both (header included) costs no more
+// than a table each; returns the sizes of the merged segments, for huffmanEncodeSegments
+std::vector<size_t> mergeHuffmanSegments(const std::vector<int>& data, const std::vector<size_t>& sizes,
+                                         int maxLength = kDefaultHuffmanLimit);
+// Same from the segments' histograms, which are replaced by those of the merged segments
+// (joined histograms are added, not recounted)
+std::vector<size_t> mergeHuffmanSegments(const std::vector<size_t>& sizes, std::vector<Histogram>& hists,
+                                         int maxLength = kDefaultHuffmanLimit);
+// Decodes every segment, switching tables at segment boundaries and advancing all of a
+// segment's streams together; stops early (printing why) on a truncated or invalid stream.
+// With maxSymbols it stops once that many symbols are out, partway through a segment if need
+// be. bitsRead, if given, receives the bits the stream readers consumed.
+std::vector<int> huffmanDecodeSegments(const SegmentedBits& bits, const std::vector<HuffmanCode>& codes,
+                                       const std::vector<size_t>& sizes, size_t maxSymbols = SIZE_MAX,
+                                       uint64_t* bitsRead = nullptr);
+
+// Self-contained encoded stream: a header with the symbol range, the symbol and bit counts and
+// the code lengths, then the packed bits. Only lengths are stored (each coded symbol as its
+// distance from the previous one plus its length under a small Huffman code of the lengths);
+// the reader rebuilds the canonical codes from them.
+std::vector<uint8_t> serializeHuffman(const HuffmanCode& code, const HuffmanBits& bits, uint64_t symbols);
+// Parses a serializeHuffman buffer; false (after printing why) if it is truncated or inconsistent.
+// headerBytes, if given, receives the size of the header.
+bool deserializeHuffman(const uint8_t* data, size_t size, HuffmanCode& code, HuffmanBits& bits,
+                        uint64_t& symbols, size_t* headerBytes = nullptr);
+
+// Self-contained per-segment stream: the segment and stream counts, then each segment's symbol
+// count, code table (stored as in serializeHuffman) and jump table, then the streams
+std::vector<uint8_t> serializeHuffmanSegments(const std::vector<HuffmanCode>& codes,
+                                              const std::vector<size_t>& sizes, const SegmentedBits& bits);
+// Parses a serializeHuffmanSegments buffer. With leadingSymbols, only the leading segments
+// holding the first leadingSymbols symbols are kept, and data need only extend over the header
+// and their streams (the jump table says where those end), so a reader can fetch a prefix.
+bool deserializeHuffmanSegments(const uint8_t* data, size_t size, std::vector<HuffmanCode>& codes,
+                                std::vector<size_t>& sizes, SegmentedBits& bits, size_t* headerBytes = nullptr,
+                                uint64_t leadingSymbols = UINT64_MAX);
@@ -1,15 +1,45 @@
 #pragma once
-#include <vector>
+#include <cstdint>
+#include <fstream>
 #include <string>
+#include "plane.hpp"
 
 // Loads a binary float image (square or rectangular)
-std::vector<std::vector<float>> loadBinImage(const std::string& path, int& rows, int& cols);
+Plane<float> loadBinImage(const std::string& path, int& rows, int& cols);
+
+// Reads the image size from the ENVI header next to a raw band file: "<name>.hdr" for
+// "<name>.bin", or "<path>.hdr". lines -> rows, samples -> cols, bands -> bands.
+// False when there is no header or it lacks samples/lines (nothing is printed in that case).
+bool readEnviHeader(const std::string& binPath, int& rows, int& cols, int& bands);
+
+// Reads a raw float band one row at a time, for scenes too large to load whole
+class BinRowReader {
+public:
+    // Opens `path` as rows of `cols` floats; fails if the size is not a whole number of rows
+    bool open(const std::string& path, int cols);
+    // Reads the next row into dst (cols floats); false at end of file or on a short read
+    bool readRow(float* dst);
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+
+private:
+    std::ifstream file_;
+    int rows_ = 0;
+    int cols_ = 0;
+};
 
 // Saves a single-channel float image as PNG/JPG (auto-clamps to [0,255])
-void saveImage(const std::vector<std::vector<float>>& image, const std::string& path);
+void saveImage(PlaneView<const float> image, const std::string& path);
 
 // Saves a 3-channel float image as PNG/JPG (auto-clamps to [0,255])
-void saveColorImage(const std::vector<std::vector<float>>& R,
-                    const std::vector<std::vector<float>>& G,
-                    const std::vector<std::vector<float>>& B,
-                    const std::string& path);
\ No newline at end of file
+void saveColorImage(PlaneView<const float> R,
+                    PlaneView<const float> G,
+                    PlaneView<const float> B,
+                    const std::string& path);
+
+// Saves a 3-channel image that is already 8-bit
+void saveColorImage(PlaneView<const uint8_t> R,
+                    PlaneView<const uint8_t> G,
+                    PlaneView<const uint8_t> B,
+                    const std::string& path);
@@ -0,0 +1,118 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// Row alignment (bytes) for Plane storage; matches a cache line and an AVX-512 register
+constexpr std::size_t kPlaneAlignment = 64;
+
+// Non-owning view of a 2D image: rows x cols elements, consecutive rows `stride` elements apart
+template <typename T>
+class PlaneView {
+public:
+    PlaneView() = default;
+    PlaneView(T* data, int rows, int cols, std::ptrdiff_t stride)
+        : data_(data), rows_(rows), cols_(cols), stride_(stride) {}
+
+    // Read-only view of a writable view
+    operator PlaneView<const T>() const { return PlaneView<const T>(data_, rows_, cols_, stride_); }
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    std::ptrdiff_t stride() const { return stride_; }
+    bool empty() const { return rows_ <= 0 || cols_ <= 0; }
+
+    T* data() const { return data_; }
+    T* row(int i) const { return data_ + i * stride_; }
+    T& operator()(int i, int j) const { return data_[i * stride_ + j]; }
+
+    // Rectangular window starting at (r0, c0), sharing this view's storage
+    PlaneView sub(int r0, int c0, int rows, int cols) const {
+        return PlaneView(data_ + r0 * stride_ + c0, rows, cols, stride_);
+    }
+
+private:
+    T* data_ = nullptr;
+    int rows_ = 0;
+    int cols_ = 0;
+    std::ptrdiff_t stride_ = 0;
+};
+
+// Owning 2D image in a single aligned allocation; each row starts on a kPlaneAlignment boundary
+template <typename T>
+class Plane {
+    static_assert(std::is_trivially_copyable<T>::value, "Plane<T> requires a trivially copyable element type");
+
+public:
+    Plane() = default;
+    Plane(int rows, int cols, T fill = T()) { resize(rows, cols, fill); }
+
+    Plane(const Plane& other) { *this = other; }
+    Plane(Plane&& other) noexcept = default;
+    Plane& operator=(Plane&& other) noexcept = default;
+    Plane& operator=(const Plane& other) {
+        if (this != &other) {
+            allocate(other.rows_, other.cols_);
+            for (int i = 0; i < rows_; ++i)
+                std::copy(other.row(i), other.row(i) + cols_, row(i));
+        }
+        return *this;
+    }
+
+    // Deep copy of any view into a freshly allocated plane
+    template <typename U>
+    static Plane copyOf(PlaneView<U> src) {
+        Plane p;
+        p.allocate(src.rows(), src.cols());
+        for (int i = 0; i < p.rows_; ++i)
+            std::copy(src.row(i), src.row(i) + p.cols_, p.row(i));
+        return p;
+    }
+
+    // Reallocates to rows x cols with every element set to `fill` (no-op on storage if the shape is unchanged)
+    void resize(int rows, int cols, T fill = T()) {
+        if (rows != rows_ || cols != cols_)
+            allocate(rows, cols);
+        std::fill(data_.get(), data_.get() + static_cast<std::size_t>(rows_) * stride_, fill);
+    }
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    std::ptrdiff_t stride() const { return stride_; }
+    bool empty() const { return rows_ <= 0 || cols_ <= 0; }
+
+    T* data() { return data_.get(); }
+    const T* data() const { return data_.get(); }
+    T* row(int i) { return data_.get() + i * stride_; }
+    const T* row(int i) const { return data_.get() + i * stride_; }
+    T& operator()(int i, int j) { return data_[i * stride_ + j]; }
+    const T& operator()(int i, int j) const { return data_[i * stride_ + j]; }
+
+    PlaneView<T> view() { return PlaneView<T>(data_.get(), rows_, cols_, stride_); }
+    PlaneView<const T> view() const { return PlaneView<const T>(data_.get(), rows_, cols_, stride_); }
+    operator PlaneView<T>() { return view(); }
+    operator PlaneView<const T>() const { return view(); }
+
+private:
+    struct AlignedDelete {
+        void operator()(T* p) const { ::operator delete[](p, std::align_val_t(kPlaneAlignment)); }
+    };
+
+    void allocate(int rows, int cols) {
+        rows_ = std::max(rows, 0);
+        cols_ = std::max(cols, 0);
+        constexpr std::ptrdiff_t perLine = static_cast<std::ptrdiff_t>(kPlaneAlignment / sizeof(T)) > 0
+                                               ? static_cast<std::ptrdiff_t>(kPlaneAlignment / sizeof(T)) : 1;
+        stride_ = (cols_ + perLine - 1) / perLine * perLine;
+        std::size_t count = static_cast<std::size_t>(rows_) * stride_;
+        data_.reset(count ? static_cast<T*>(::operator new[](count * sizeof(T), std::align_val_t(kPlaneAlignment)))
+                          : nullptr);
+    }
+
+    std::unique_ptr<T[], AlignedDelete> data_;
+    int rows_ = 0;
+    int cols_ = 0;
+    std::ptrdiff_t stride_ = 0;
+};
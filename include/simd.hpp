@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+// Minimal float / int32 SIMD layer used by the DWT kernels.
+// Picks AVX2 (8 lanes), SSE2 (4 lanes) or plain scalar (1 lane) at compile time;
+// kernels are written once against these helpers and run at whatever width was built.
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE2 1
+#endif
+
+namespace simd {
+
+#if defined(SIMD_AVX2)
+constexpr int kWidth = 8;
+constexpr const char* kName = "AVX2";
+using Vec = __m256;
+inline Vec load(const float* p) { return _mm256_loadu_ps(p); }
+inline void store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+inline Vec set1(float c) { return _mm256_set1_ps(c); }
+inline Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+
+// int32 lanes (same width as the float ones) for the reversible integer transform
+using VecI = __m256i;
+inline VecI loadi(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline void storei(int32_t* p, VecI v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+inline VecI set1i(int32_t c) { return _mm256_set1_epi32(c); }
+inline VecI addi(VecI a, VecI b) { return _mm256_add_epi32(a, b); }
+inline VecI subi(VecI a, VecI b) { return _mm256_sub_epi32(a, b); }
+template <int S> inline VecI srai(VecI a) { return _mm256_srai_epi32(a, S); }
+inline VecI mini(VecI a, VecI b) { return _mm256_min_epi32(a, b); }
+inline VecI maxi(VecI a, VecI b) { return _mm256_max_epi32(a, b); }
+
+// 2*kWidth interleaved floats -> kWidth even-indexed and kWidth odd-indexed floats
+inline void deinterleave(const float* src, Vec& even, Vec& odd) {
+    Vec a = _mm256_loadu_ps(src), b = _mm256_loadu_ps(src + 8);
+    Vec e = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));  // a0 a2 b0 b2 | a4 a6 b4 b6
+    Vec o = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    even = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(e), _MM_SHUFFLE(3, 1, 2, 0)));
+    odd = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(o), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// Inverse of deinterleave: writes e0 o0 e1 o1 ... (2*kWidth floats)
+inline void interleave(float* dst, Vec even, Vec odd) {
+    Vec lo = _mm256_unpacklo_ps(even, odd);  // e0 o0 e1 o1 | e4 o4 e5 o5
+    Vec hi = _mm256_unpackhi_ps(even, odd);  // e2 o2 e3 o3 | e6 o6 e7 o7
+    _mm256_storeu_ps(dst, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+#elif defined(SIMD_SSE2)
+constexpr int kWidth = 4;
+constexpr const char* kName = "SSE2";
+using Vec = __m128;
+inline Vec load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+inline Vec set1(float c) { return _mm_set1_ps(c); }
+inline Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+
+using VecI = __m128i;
+inline VecI loadi(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline void storei(int32_t* p, VecI v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+inline VecI set1i(int32_t c) { return _mm_set1_epi32(c); }
+inline VecI addi(VecI a, VecI b) { return _mm_add_epi32(a, b); }
+inline VecI subi(VecI a, VecI b) { return _mm_sub_epi32(a, b); }
+template <int S> inline VecI srai(VecI a) { return _mm_srai_epi32(a, S); }
+// SSE2 has no 32-bit min/max (SSE4.1 does): select through a compare mask
+inline VecI mini(VecI a, VecI b) {
+    VecI gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+inline VecI maxi(VecI a, VecI b) {
+    VecI gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+inline void deinterleave(const float* src, Vec& even, Vec& odd) {
+    Vec a = _mm_loadu_ps(src), b = _mm_loadu_ps(src + 4);
+    even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+inline void interleave(float* dst, Vec even, Vec odd) {
+    _mm_storeu_ps(dst, _mm_unpacklo_ps(even, odd));
+    _mm_storeu_ps(dst + 4, _mm_unpackhi_ps(even, odd));
+}
+#else
+constexpr int kWidth = 1;
+constexpr const char* kName = "scalar";
+using Vec = float;
+inline Vec load(const float* p) { return *p; }
+inline void store(float* p, Vec v) { *p = v; }
+inline Vec set1(float c) { return c; }
+inline Vec add(Vec a, Vec b) { return a + b; }
+inline Vec sub(Vec a, Vec b) { return a - b; }
+inline Vec mul(Vec a, Vec b) { return a * b; }
+
+using VecI = int32_t;
+inline VecI loadi(const int32_t* p) { return *p; }
+inline void storei(int32_t* p, VecI v) { *p = v; }
+inline VecI set1i(int32_t c) { return c; }
+inline VecI addi(VecI a, VecI b) { return a + b; }
+inline VecI subi(VecI a, VecI b) { return a - b; }
+template <int S> inline VecI srai(VecI a) { return a >> S; }
+inline VecI mini(VecI a, VecI b) { return a < b ? a : b; }
+inline VecI maxi(VecI a, VecI b) { return a > b ? a : b; }
+
+inline void deinterleave(const float* src, Vec& even, Vec& odd) {
+    even = src[0];
+    odd = src[1];
+}
+
+inline void interleave(float* dst, Vec even, Vec odd) {
+    dst[0] = even;
+    dst[1] = odd;
+}
+#endif
+
+}  // namespace simd
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads with one task deque each. A parallelFor pushes its indices onto
+// the calling thread's deque; the owner pops from the back, idle threads steal from the front.
+// Waiting callers run queued tasks instead of blocking, so parallelFor may be called from
+// inside a task (a per-band task can spread its own DWT over the pool) without deadlocking.
+class ThreadPool {
+public:
+    // threads <= 0 picks std::thread::hardware_concurrency(); the pool spawns threads - 1 workers
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads that execute work, including the caller
+    int size() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Runs fn(i) for every i in [0, count) across the pool and returns once all have finished.
+    // Any thread, including a pool task, may call it; callers on other threads share one deque.
+    void parallelFor(int count, const std::function<void(int)>& fn);
+
+private:
+    struct Task {
+        const std::function<void(int)>* fn;
+        int index;
+        std::atomic<int>* remaining;  // tasks of the same parallelFor still to finish
+    };
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(int self);
+    int queueIndex() const;
+    bool runOne(int self);
+    bool popTask(int self, Task& task);
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<TaskQueue>> queues_;  // [0]: threads outside the pool, [i]: worker i
+
+    std::mutex idleMutex_;
+    std::condition_variable idle_;  // new tasks, a finished parallelFor, or shutdown
+    std::atomic<int> queued_{0};
+    bool stop_ = false;
+};
@@ -1,13 +1,16 @@
 #pragma once
+#include <iostream>
 #include <vector>
+#include "plane.hpp"
 
-std::vector<int> flatten(const std::vector<std::vector<float>>& mat);
-std::vector<std::vector<float>> unflatten(const std::vector<int>& vec, int rows, int cols);
-void evaluate(const std::vector<std::vector<float>>& orig, const std::vector<std::vector<float>>& recon);
+std::vector<int> flatten(PlaneView<const float> mat);
+Plane<float> unflatten(const std::vector<int>& vec, int rows, int cols);
+void unflatten(const int* data, PlaneView<float> dst);  // fills dst row by row from data
+void evaluate(PlaneView<const float> orig, PlaneView<const float> recon, std::ostream& os = std::cout);  // prints MSE and PSNR
 
-double computeSSIM(const std::vector<std::vector<float>>& img1,
-                   const std::vector<std::vector<float>>& img2);
+double computeSSIM(PlaneView<const float> img1,
+                   PlaneView<const float> img2);
 
 double computeMeanSAM(
-    const std::vector<std::vector<std::vector<float>>>& original,
-    const std::vector<std::vector<std::vector<float>>>& reconstructed);
\ No newline at end of file
+    const std::vector<Plane<float>>& original,
+    const std::vector<Plane<float>>& reconstructed);
@@ -1,165 +1,350 @@
 #include "dwt_db4.hpp"
+#include "dwt_kernels.hpp"
+#include "dwt_plan.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
 #include <cmath>
 #include <iostream>
 #include <vector>
 #include <algorithm>
 
-// Daubechies-4 coefficients
-static const float h[] = { 0.4829629131f, 0.8365163037f, 0.2241438680f, -0.1294095226f };
-static const float g[] = { -0.1294095226f, -0.2241438680f, 0.8365163037f, -0.4829629131f };
+using namespace dwt_kernels;
 
-// Symmetric padding for 1D vector
-static std::vector<float> padSymmetric(const std::vector<float>& input, int pad) {
-    int N = input.size();
-    std::vector<float> padded(N + 2 * pad);
-    for (int i = 0; i < pad; ++i) {
-        padded[i] = input[pad - i];                      // mirror left
-        padded[N + pad + i] = input[N - 2 - i];          // mirror right
-    }
-    for (int i = 0; i < N; ++i)
-        padded[pad + i] = input[i];
-    return padded;
+const char* dwtKernelIsa() {
+    return simd::kName;
 }
 
 // 1D DWT
-void dwt1D(const std::vector<float>& input, std::vector<float>& approx, std::vector<float>& detail) {
+void dwt1D(const std::vector<float>& input, std::vector<float>& approx, std::vector<float>& detail,
+           DwtMethod method) {
     int N = input.size();
     if (N < 4 || N % 2 != 0) {
         approx.clear();
         detail.clear();
         return;
     }
-    std::vector<float> padded = padSymmetric(input, 2);
     approx.resize(N / 2);
     detail.resize(N / 2);
-    for (int i = 0, k = 0; i < N; i += 2, ++k) {
-        approx[k] = detail[k] = 0.0f;
-        for (int j = 0; j < 4; ++j) {
-            approx[k] += h[j] * padded[i + j];
-            detail[k] += g[j] * padded[i + j];
-        }
-    }
+    std::vector<float> even(N / 2 + 1), odd(N / 2 + 1);
+    if (method == DwtMethod::Lifting)
+        liftRowForward(input.data(), N, approx.data(), detail.data(), odd.data());
+    else
+        convRowForward(input.data(), N, approx.data(), detail.data(), even.data(), odd.data());
 }
 
 // 1D inverse DWT
-std::vector<float> idwt1D(const std::vector<float>& approx, const std::vector<float>& detail) {
+std::vector<float> idwt1D(const std::vector<float>& approx, const std::vector<float>& detail,
+                          DwtMethod method) {
     int N = approx.size();
     std::vector<float> result(N * 2, 0.0f);
-    for (int k = 0; k < N; ++k) {
-        for (int j = 0; j < 4; ++j) {
-            int i = 2 * k + j;
-            if (i < result.size())
-                result[i] += h[j] * approx[k] + g[j] * detail[k];
-        }
-    }
+    if (detail.size() != approx.size() || N == 0)
+        return result;
+    std::vector<float> even(N), odd(N);
+    if (method == DwtMethod::Lifting)
+        liftRowInverse(approx.data(), detail.data(), N, result.data(), even.data(), odd.data());
+    else
+        convRowInverse(approx.data(), detail.data(), N, result.data(), even.data(), odd.data());
     return result;
 }
 
 // 2D DWT (db4)
-void dwt2D_db4(const std::vector<std::vector<float>>& input,
-               std::vector<std::vector<float>>& LL,
-               std::vector<std::vector<float>>& LH,
-               std::vector<std::vector<float>>& HL,
-               std::vector<std::vector<float>>& HH) {
-    int h = input.size();
+void dwt2D_db4(PlaneView<const float> input,
+               Plane<float>& LL,
+               Plane<float>& LH,
+               Plane<float>& HL,
+               Plane<float>& HH,
+               DwtMethod method,
+               ThreadPool* pool) {
+    int h = input.rows();
     if (h == 0) {
         std::cerr << "Error: Input has no rows." << std::endl;
         return;
     }
-    int w = input[0].size();
-
-    // Check all rows are the same size
-    for (size_t i = 0; i < input.size(); ++i) {
-        if (input[i].size() != static_cast<size_t>(w)) {
-            std::cerr << "Error: Input rows are not all of equal length." << std::endl;
-            return;
-        }
-    }
+    int w = input.cols();
 
-    if (h % 2 != 0 || w % 2 != 0) {
-        std::cerr << "Error: Input dimensions must be even for DWT." << std::endl;
+    if (h % 2 != 0 || w % 2 != 0 || h < 4 || w < 4) {
+        std::cerr << "Error: Input dimensions must be even (and at least 4) for DWT." << std::endl;
         return;
     }
 
-    std::vector<std::vector<float>> lowRows(h), highRows(h);
-
-    // First pass: row-wise DWT
-    for (int i = 0; i < h; ++i) {
-        dwt1D(input[i], lowRows[i], highRows[i]);
-    }
-
     int halfH = h / 2, halfW = w / 2;
-    LL.assign(halfH, std::vector<float>(halfW));
-    LH.assign(halfH, std::vector<float>(halfW));
-    HL.assign(halfH, std::vector<float>(halfW));
-    HH.assign(halfH, std::vector<float>(halfW));
-
-    // Second pass: column-wise DWT
-    for (int j = 0; j < halfW; ++j) {
-        std::vector<float> colL(h), colH(h);
-        for (int i = 0; i < h; ++i) {
-            colL[i] = lowRows[i][j];
-            colH[i] = highRows[i][j];
-        }
+    Plane<float> lowRows(h, halfW), highRows(h, halfW);
+    LL.resize(halfH, halfW);
+    LH.resize(halfH, halfW);
+    HL.resize(halfH, halfW);
+    HH.resize(halfH, halfW);
 
-        std::vector<float> La, Ld, Ha, Hd;
-        dwt1D(colL, La, Ld);
-        dwt1D(colH, Ha, Hd);
+    // First pass: row-wise DWT over horizontal strips
+    int strips = rowStripCount(h, pool);
+    forEachPart(pool, strips, [&](int s) {
+        std::vector<float> even(halfW + 1), odd(halfW + 1);
+        for (int i = h * s / strips; i < h * (s + 1) / strips; ++i) {
+            if (method == DwtMethod::Lifting)
+                liftRowForward(input.row(i), w, lowRows.row(i), highRows.row(i), odd.data());
+            else
+                convRowForward(input.row(i), w, lowRows.row(i), highRows.row(i), even.data(), odd.data());
+        }
+    });
 
-        for (int i = 0; i < halfH; ++i) {
-            LL[i][j] = La[i];
-            LH[i][j] = Ha[i];
-            HL[i][j] = Ld[i];
-            HH[i][j] = Hd[i];
+    // Second pass: column-wise DWT over column tiles
+    int tile = columnTileWidth(halfW, pool);
+    forEachPart(pool, (halfW + tile - 1) / tile, [&](int t) {
+        int c0 = t * tile;
+        int tw = std::min(tile, halfW - c0);
+        PlaneView<float> low = lowRows.view().sub(0, c0, h, tw);
+        PlaneView<float> high = highRows.view().sub(0, c0, h, tw);
+        PlaneView<float> ll = LL.view().sub(0, c0, halfH, tw), hl = HL.view().sub(0, c0, halfH, tw);
+        PlaneView<float> lh = LH.view().sub(0, c0, halfH, tw), hh = HH.view().sub(0, c0, halfH, tw);
+        if (method == DwtMethod::Lifting) {
+            liftColumnsForward(low, ll, hl);
+            liftColumnsForward(high, lh, hh);
+        } else {
+            convColumnsForward(low, ll, hl);
+            convColumnsForward(high, lh, hh);
         }
-    }
+    });
 }
 
 // 2D inverse DWT (db4)
-std::vector<std::vector<float>> idwt2D_db4(const std::vector<std::vector<float>>& LL,
-                                           const std::vector<std::vector<float>>& LH,
-                                           const std::vector<std::vector<float>>& HL,
-                                           const std::vector<std::vector<float>>& HH) {
-    if (LL.empty() || LL[0].empty() ||
-        LH.size() != LL.size() || HL.size() != LL.size() || HH.size() != LL.size() ||
-        LH[0].size() != LL[0].size() || HL[0].size() != LL[0].size() || HH[0].size() != LL[0].size()) {
+Plane<float> idwt2D_db4(PlaneView<const float> LL,
+                        PlaneView<const float> LH,
+                        PlaneView<const float> HL,
+                        PlaneView<const float> HH,
+                        DwtMethod method,
+                        ThreadPool* pool) {
+    if (LL.empty() ||
+        LH.rows() != LL.rows() || HL.rows() != LL.rows() || HH.rows() != LL.rows() ||
+        LH.cols() != LL.cols() || HL.cols() != LL.cols() || HH.cols() != LL.cols()) {
         std::cerr << "Error: Subbands must be non-empty and of equal dimensions." << std::endl;
         return {};
     }
 
-    int h = LL.size();
-    int w = LL[0].size();
-    std::vector<std::vector<float>> lowRows(2 * h, std::vector<float>(w));
-    std::vector<std::vector<float>> highRows(2 * h, std::vector<float>(w));
-
-    // First pass: column-wise inverse DWT
-    for (int j = 0; j < w; ++j) {
-        std::vector<float> colLL(h), colLH(h), colHL(h), colHH(h);
-        for (int i = 0; i < h; ++i) {
-            colLL[i] = LL[i][j];
-            colHL[i] = HL[i][j];
-            colLH[i] = LH[i][j];
-            colHH[i] = HH[i][j];
+    int h = LL.rows();
+    int w = LL.cols();
+    Plane<float> lowRows(2 * h, w);
+    Plane<float> highRows(2 * h, w);
+    Plane<float> output(2 * h, 2 * w);
+
+    // First pass: column-wise inverse DWT over column tiles
+    int tile = columnTileWidth(w, pool);
+    forEachPart(pool, (w + tile - 1) / tile, [&](int t) {
+        int c0 = t * tile;
+        int tw = std::min(tile, w - c0);
+        PlaneView<float> low = lowRows.view().sub(0, c0, 2 * h, tw);
+        PlaneView<float> high = highRows.view().sub(0, c0, 2 * h, tw);
+        if (method == DwtMethod::Lifting) {
+            liftColumnsInverse(LL.sub(0, c0, h, tw), HL.sub(0, c0, h, tw), low);
+            liftColumnsInverse(LH.sub(0, c0, h, tw), HH.sub(0, c0, h, tw), high);
+        } else {
+            convColumnsInverse(LL.sub(0, c0, h, tw), HL.sub(0, c0, h, tw), low);
+            convColumnsInverse(LH.sub(0, c0, h, tw), HH.sub(0, c0, h, tw), high);
+        }
+    });
+
+    // Second pass: row-wise inverse DWT over horizontal strips
+    int strips = rowStripCount(2 * h, pool);
+    forEachPart(pool, strips, [&](int s) {
+        std::vector<float> even(w), odd(w);
+        for (int i = 2 * h * s / strips; i < 2 * h * (s + 1) / strips; ++i) {
+            if (method == DwtMethod::Lifting)
+                liftRowInverse(lowRows.row(i), highRows.row(i), w, output.row(i), even.data(), odd.data());
+            else
+                convRowInverse(lowRows.row(i), highRows.row(i), w, output.row(i), even.data(), odd.data());
         }
+    });
+
+    return output;
+}
+
+std::vector<std::pair<int, Subband>> pyramidCodingOrder(int levels) {
+    std::vector<std::pair<int, Subband>> order;
+    order.emplace_back(levels, Subband::LL);
+    for (int l = levels; l >= 1; --l) {
+        order.emplace_back(l, Subband::LH);
+        order.emplace_back(l, Subband::HL);
+        order.emplace_back(l, Subband::HH);
+    }
+    return order;
+}
+
+std::vector<size_t> pyramidCodingSizes(int rows, int cols, int levels) {
+    std::vector<size_t> sizes;
+    for (const auto& [level, band] : pyramidCodingOrder(levels)) {
+        int h = pyramidExtent(rows, level - 1), w = pyramidExtent(cols, level - 1);
+        int lowH = (h + 1) / 2, lowW = (w + 1) / 2;
+        int bandH = band == Subband::LL || band == Subband::LH ? lowH : h - lowH;
+        int bandW = band == Subband::LL || band == Subband::HL ? lowW : w - lowW;
+        sizes.push_back(static_cast<size_t>(bandH) * bandW);
+    }
+    return sizes;
+}
 
-        std::vector<float> lowCol = idwt1D(colLL, colHL);
-        std::vector<float> highCol = idwt1D(colLH, colHH);
+static bool spectralShapeOk(const std::vector<Plane<float>>& cube, int levels) {
+    int bands = static_cast<int>(cube.size());
+    if (levels < 1 || bands % (1 << levels) != 0 || (bands >> (levels - 1)) < 4) {
+        std::cerr << "Error: " << bands << " bands cannot take " << levels << " spectral DWT levels." << std::endl;
+        return false;
+    }
+    for (const Plane<float>& p : cube) {
+        if (p.rows() != cube[0].rows() || p.cols() != cube[0].cols()) {
+            std::cerr << "Error: cube bands have inconsistent sizes." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
 
-        for (int i = 0; i < 2 * h; ++i) {
-            lowRows[i][j] = lowCol[i];
-            highRows[i][j] = highCol[i];
+// One spectral level over planes [0, n). For each image row, the n band rows are gathered
+// into a small n x cols tile so the column kernels run along the band axis.
+static void spectralLevel(std::vector<Plane<float>>& cube, int n, bool forward, DwtMethod method, ThreadPool* pool) {
+    int rows = cube[0].rows(), cols = cube[0].cols();
+    int half = n / 2;
+    int strips = rowStripCount(rows, pool);
+    forEachPart(pool, strips, [&](int s) {
+        Plane<float> in(n, cols), out(n, cols);
+        for (int i = rows * s / strips; i < rows * (s + 1) / strips; ++i) {
+            for (int b = 0; b < n; ++b)
+                std::copy(cube[b].row(i), cube[b].row(i) + cols, in.row(b));
+            PlaneView<float> lo = out.view().sub(0, 0, half, cols);
+            PlaneView<float> hi = out.view().sub(half, 0, half, cols);
+            if (forward) {
+                if (method == DwtMethod::Lifting)
+                    liftColumnsForward(in, lo, hi);
+                else
+                    convColumnsForward(in, lo, hi);
+            } else {
+                PlaneView<const float> inLo = in.view().sub(0, 0, half, cols);
+                PlaneView<const float> inHi = in.view().sub(half, 0, half, cols);
+                if (method == DwtMethod::Lifting)
+                    liftColumnsInverse(inLo, inHi, out);
+                else
+                    convColumnsInverse(inLo, inHi, out);
+            }
+            for (int b = 0; b < n; ++b)
+                std::copy(out.row(b), out.row(b) + cols, cube[b].row(i));
         }
+    });
+}
+
+bool dwtSpectral(std::vector<Plane<float>>& cube, int levels, DwtMethod method, ThreadPool* pool) {
+    if (!spectralShapeOk(cube, levels)) return false;
+    int bands = static_cast<int>(cube.size());
+    for (int l = 0; l < levels; ++l)
+        spectralLevel(cube, bands >> l, true, method, pool);
+    return true;
+}
+
+bool idwtSpectral(std::vector<Plane<float>>& cube, int levels, DwtMethod method, ThreadPool* pool) {
+    if (!spectralShapeOk(cube, levels)) return false;
+    int bands = static_cast<int>(cube.size());
+    for (int l = levels - 1; l >= 0; --l)
+        spectralLevel(cube, bands >> l, false, method, pool);
+    return true;
+}
+
+Plane<float> interleaveBands(const std::vector<Plane<float>>& cube, int first, int count) {
+    Plane<float> bip(cube[first].rows(), cube[first].cols() * count);
+    interleaveBands(cube, first, count, bip);
+    return bip;
+}
+
+// Four band rows a, b, c, d -> a0 b0 c0 d0 a1 ... for pixels [0, n), kWidth pixels per step:
+// interleaving (a, c) and (b, d), then the two results, puts every sample in its slot
+static int interleave4(const float* const* src, int n, float* dst) {
+    constexpr int W = simd::kWidth;
+    alignas(32) float ac[2 * W], bd[2 * W];
+    int j = 0;
+    for (; j + W <= n; j += W, dst += 4 * W) {
+        simd::interleave(ac, simd::load(src[0] + j), simd::load(src[2] + j));
+        simd::interleave(bd, simd::load(src[1] + j), simd::load(src[3] + j));
+        simd::interleave(dst, simd::load(ac), simd::load(bd));
+        simd::interleave(dst + 2 * W, simd::load(ac + W), simd::load(bd + W));
     }
+    return j;
+}
 
-    // Second pass: row-wise inverse DWT
-    std::vector<std::vector<float>> output(2 * h, std::vector<float>(2 * w));
-    for (int i = 0; i < 2 * h; ++i) {
-        if (lowRows[i].size() != static_cast<size_t>(w) || highRows[i].size() != static_cast<size_t>(w)) {
-            std::cerr << "Error: Inconsistent row sizes during reconstruction." << std::endl;
-            return {};
+// Inverse of interleave4
+static int deinterleave4(const float* src, int n, float* const* dst) {
+    constexpr int W = simd::kWidth;
+    alignas(32) float ac[2 * W], bd[2 * W];
+    int j = 0;
+    for (; j + W <= n; j += W, src += 4 * W) {
+        simd::Vec e, o;
+        simd::deinterleave(src, e, o);
+        simd::store(ac, e);
+        simd::store(bd, o);
+        simd::deinterleave(src + 2 * W, e, o);
+        simd::store(ac + W, e);
+        simd::store(bd + W, o);
+        simd::deinterleave(ac, e, o);
+        simd::store(dst[0] + j, e);
+        simd::store(dst[2] + j, o);
+        simd::deinterleave(bd, e, o);
+        simd::store(dst[1] + j, e);
+        simd::store(dst[3] + j, o);
+    }
+    return j;
+}
+
+void interleaveBands(const std::vector<Plane<float>>& cube, int first, int count, PlaneView<float> bip) {
+    int rows = cube[first].rows(), cols = cube[first].cols();
+    std::vector<const float*> src(count);
+    for (int i = 0; i < rows; ++i) {
+        for (int b = 0; b < count; ++b)
+            src[b] = cube[first + b].row(i);
+        // One pass over the row per pixel, so the stores stay sequential
+        int j = count == 4 ? interleave4(src.data(), cols, bip.row(i)) : 0;
+        for (float* dst = bip.row(i) + j * count; j < cols; ++j, dst += count)
+            for (int b = 0; b < count; ++b)
+                dst[b] = src[b][j];
+    }
+}
+
+void deinterleaveBands(PlaneView<const float> bip, int count, std::vector<Plane<float>>& cube, int first) {
+    int rows = bip.rows(), cols = bip.cols() / count;
+    std::vector<float*> dst(count);
+    for (int i = 0; i < rows; ++i) {
+        for (int b = 0; b < count; ++b)
+            dst[b] = cube[first + b].row(i);
+        int j = count == 4 ? deinterleave4(bip.row(i), cols, dst.data()) : 0;
+        for (const float* src = bip.row(i) + j * count; j < cols; ++j, src += count)
+            for (int b = 0; b < count; ++b)
+                dst[b][j] = src[b];
+    }
+}
+
+// Spatial pyramid of every plane, kBipBatch planes at a time through one band-interleaved plan
+// (the SIMD lanes run across the planes of each pixel). Convolution has no interleaved row
+// kernel of its own, and a single leftover plane has nothing to batch with, so those take
+// the per-band path. Either way every plane comes out exactly as from its own dwtPyramid.
+static bool spatialPass(std::vector<Plane<float>>& cube, int levels, bool forward, DwtMethod method,
+                        ThreadPool* pool) {
+    const int planes = static_cast<int>(cube.size());
+    const int rows = cube[0].rows(), cols = cube[0].cols();
+    const int batch = method == DwtMethod::Lifting ? std::min(kBipBatch, planes) : 1;
+    Plane<float> bip(rows, cols * batch);
+    DwtPlan plan(rows, cols, levels, method, pool, batch);
+    for (int first = 0, count = batch; first < planes; first += count) {
+        count = std::min(batch, planes - first);
+        if (count != plan.bands()) plan = DwtPlan(rows, cols, levels, method, pool, count);
+        if (!plan.valid()) return false;
+        if (count == 1) {
+            if (!(forward ? plan.forward(cube[first]) : plan.inverse(cube[first]))) return false;
+            continue;
         }
-        output[i] = idwt1D(lowRows[i], highRows[i]);
+        PlaneView<float> view = bip.view().sub(0, 0, rows, cols * count);
+        interleaveBands(cube, first, count, view);
+        if (!(forward ? plan.forward(view) : plan.inverse(view))) return false;
+        deinterleaveBands(view, count, cube, first);
     }
+    return true;
+}
 
-    return output;
-}
\ No newline at end of file
+bool dwt3D(std::vector<Plane<float>>& cube, int spectralLevels, int spatialLevels, DwtMethod method, ThreadPool* pool) {
+    return dwtSpectral(cube, spectralLevels, method, pool) && spatialPass(cube, spatialLevels, true, method, pool);
+}
+
+bool idwt3D(std::vector<Plane<float>>& cube, int spectralLevels, int spatialLevels, DwtMethod method, ThreadPool* pool) {
+    if (cube.empty()) return false;
+    return spatialPass(cube, spatialLevels, false, method, pool) && idwtSpectral(cube, spectralLevels, method, pool);
+}
@@ -0,0 +1,434 @@
+#include "dwt_kernels.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace dwt_kernels {
+
+// Daubechies-4 coefficients
+const float kDb4Low[] = { 0.4829629131f, 0.8365163037f, 0.2241438680f, -0.1294095226f };
+const float kDb4High[] = { -0.1294095226f, -0.2241438680f, 0.8365163037f, -0.4829629131f };
+
+// Synthesis taps for even / odd outputs: x[2m] and x[2m+1] from (a[m-1], d[m-1], a[m], d[m])
+static const float synthEven[] = { kDb4Low[2], kDb4High[2], kDb4Low[0], kDb4High[0] };
+static const float synthOdd[] = { kDb4Low[3], kDb4High[3], kDb4Low[1], kDb4High[1] };
+
+// db4 lifting constants (Daubechies & Sweldens factorization of h[]/g[])
+static const float kSqrt3 = 1.7320508076f;
+static const float kUpdate0 = 0.4330127019f;    // sqrt(3) / 4
+static const float kUpdate1 = -0.0669872981f;   // (sqrt(3) - 2) / 4
+static const float kScaleLow = 0.5176380902f;   // (sqrt(3) - 1) / sqrt(2)
+static const float kScaleHigh = 1.9318516526f;  // (sqrt(3) + 1) / sqrt(2)
+
+void forEachPart(ThreadPool* pool, int count, const std::function<void(int)>& fn) {
+    if (pool)
+        pool->parallelFor(count, fn);
+    else
+        for (int i = 0; i < count; ++i)
+            fn(i);
+}
+
+int rowStripCount(int rows, ThreadPool* pool) {
+    if (!pool || pool->size() == 1) return 1;
+    return std::min(rows, pool->size() * 4);
+}
+
+int columnTileWidth(int cols, ThreadPool* pool) {
+    if (!pool || pool->size() == 1) return kColumnTile;
+    const int line = 16;
+    int perThread = (cols + pool->size() - 1) / pool->size();
+    perThread = (perThread + line - 1) / line * line;
+    return std::min(kColumnTile, perThread);
+}
+
+bool pyramidShapeOk(int rows, int cols, int levels) {
+    if (levels < 1) return false;
+    for (int l = 0; l < levels; ++l, rows = (rows + 1) / 2, cols = (cols + 1) / 2)
+        if (rows < 4 || cols < 4) return false;
+    return true;
+}
+
+// Whole-sample symmetric extension of index m into [0, N)
+int mirrorIndex(int m, int N) {
+    if (m < 0) return -m;
+    if (m >= N) return 2 * N - 2 - m;
+    return m;
+}
+
+// ---------------------------------------------------------------------------
+// Element-wise kernels over n contiguous floats. Every pass of the transform is
+// built from these: vertical passes hand them whole rows (so adjacent columns
+// fill the SIMD lanes), horizontal passes hand them the deinterleaved halves.
+// The scalar tail evaluates exactly the same expression as the vector body.
+// ---------------------------------------------------------------------------
+
+// y = c * x
+void scaleRow(float* y, const float* x, float c, int n) {
+    const simd::Vec vc = simd::set1(c);
+    int j = 0;
+    for (; j + simd::kWidth <= n; j += simd::kWidth)
+        simd::store(y + j, simd::mul(vc, simd::load(x + j)));
+    for (; j < n; ++j)
+        y[j] = c * x[j];
+}
+
+// y += c * x
+void addScaledRow(float* y, const float* x, float c, int n) {
+    const simd::Vec vc = simd::set1(c);
+    int j = 0;
+    for (; j + simd::kWidth <= n; j += simd::kWidth)
+        simd::store(y + j, simd::add(simd::load(y + j), simd::mul(vc, simd::load(x + j))));
+    for (; j < n; ++j)
+        y[j] = y[j] + c * x[j];
+}
+
+// y += c0 * x0 + c1 * x1
+void addScaled2Row(float* y, const float* x0, const float* x1, float c0, float c1, int n) {
+    const simd::Vec v0 = simd::set1(c0), v1 = simd::set1(c1);
+    int j = 0;
+    for (; j + simd::kWidth <= n; j += simd::kWidth) {
+        simd::Vec t = simd::add(simd::mul(v0, simd::load(x0 + j)), simd::mul(v1, simd::load(x1 + j)));
+        simd::store(y + j, simd::add(simd::load(y + j), t));
+    }
+    for (; j < n; ++j)
+        y[j] = y[j] + (c0 * x0[j] + c1 * x1[j]);
+}
+
+// y = c0 * x0 + c1 * x1
+void combine2Row(float* y, const float* x0, const float* x1, float c0, float c1, int n) {
+    const simd::Vec v0 = simd::set1(c0), v1 = simd::set1(c1);
+    int j = 0;
+    for (; j + simd::kWidth <= n; j += simd::kWidth)
+        simd::store(y + j, simd::add(simd::mul(v0, simd::load(x0 + j)), simd::mul(v1, simd::load(x1 + j))));
+    for (; j < n; ++j)
+        y[j] = c0 * x0[j] + c1 * x1[j];
+}
+
+// y = (c[0] * x0 + c[1] * x1) + (c[2] * x2 + c[3] * x3)
+void combine4Row(float* y, const float* x0, const float* x1, const float* x2, const float* x3,
+                        const float* c, int n) {
+    const simd::Vec v0 = simd::set1(c[0]), v1 = simd::set1(c[1]);
+    const simd::Vec v2 = simd::set1(c[2]), v3 = simd::set1(c[3]);
+    int j = 0;
+    for (; j + simd::kWidth <= n; j += simd::kWidth) {
+        simd::Vec p = simd::add(simd::mul(v0, simd::load(x0 + j)), simd::mul(v1, simd::load(x1 + j)));
+        simd::Vec q = simd::add(simd::mul(v2, simd::load(x2 + j)), simd::mul(v3, simd::load(x3 + j)));
+        simd::store(y + j, simd::add(p, q));
+    }
+    for (; j < n; ++j)
+        y[j] = (c[0] * x0[j] + c[1] * x1[j]) + (c[2] * x2[j] + c[3] * x3[j]);
+}
+
+// Interleaved x[0..2M) -> even[0..M), odd[0..M)
+void splitRow(const float* x, float* even, float* odd, int M) {
+    int k = 0;
+    for (; k + simd::kWidth <= M; k += simd::kWidth) {
+        simd::Vec e, o;
+        simd::deinterleave(x + 2 * k, e, o);
+        simd::store(even + k, e);
+        simd::store(odd + k, o);
+    }
+    for (; k < M; ++k) {
+        even[k] = x[2 * k];
+        odd[k] = x[2 * k + 1];
+    }
+}
+
+// even[0..M), odd[0..M) -> interleaved x[0..2M)
+void mergeRow(const float* even, const float* odd, float* x, int M) {
+    int k = 0;
+    for (; k + simd::kWidth <= M; k += simd::kWidth)
+        simd::interleave(x + 2 * k, simd::load(even + k), simd::load(odd + k));
+    for (; k < M; ++k) {
+        x[2 * k] = even[k];
+        x[2 * k + 1] = odd[k];
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Horizontal (single row) transforms
+// ---------------------------------------------------------------------------
+
+// Convolution db4 of one row (N even, N >= 4); `even`/`odd` are scratch of N/2 + 1 floats
+void convRowForward(const float* x, int N, float* lo, float* hi, float* even, float* odd) {
+    int M = N / 2;
+    // even[k] = x[2k-2], odd[k] = x[2k-1], with x[-2] = x[2] and x[-1] = x[1] (symmetric padding)
+    splitRow(x, even + 1, odd + 1, M);
+    even[0] = even[2];
+    odd[0] = odd[1];
+    combine4Row(lo, even, odd, even + 1, odd + 1, kDb4Low, M);
+    combine4Row(hi, even, odd, even + 1, odd + 1, kDb4High, M);
+}
+
+// Inverse convolution db4 of one row (M coefficients per band); `even`/`odd` are scratch of M floats
+void convRowInverse(const float* lo, const float* hi, int M, float* out, float* even, float* odd) {
+    combine2Row(even, lo, hi, kDb4Low[0], kDb4High[0], 1);
+    combine2Row(odd, lo, hi, kDb4Low[1], kDb4High[1], 1);
+    combine4Row(even + 1, lo, hi, lo + 1, hi + 1, synthEven, M - 1);
+    combine4Row(odd + 1, lo, hi, lo + 1, hi + 1, synthOdd, M - 1);
+    mergeRow(even, odd, out, M);
+}
+
+// Forward db4 lifting of one row (N even) with periodic extension: split into lo/odd,
+// then predict / update / predict / scale. The detail band is rotated by one so
+// the output matches the periodic convolution a[k] = sum h[j] x[2k+j], d[k] = sum g[j] x[2k+j].
+// `odd` is scratch of N/2 floats.
+void liftRowForward(const float* x, int N, float* lo, float* hi, float* odd) {
+    int M = N / 2;
+    splitRow(x, lo, odd, M);
+    addScaledRow(lo, odd, kSqrt3, M);
+    addScaled2Row(odd, lo, lo + M - 1, -kUpdate0, -kUpdate1, 1);
+    addScaled2Row(odd + 1, lo + 1, lo, -kUpdate0, -kUpdate1, M - 1);
+    addScaledRow(lo, odd + 1, -1.0f, M - 1);
+    addScaledRow(lo + M - 1, odd, -1.0f, 1);
+    scaleRow(lo, lo, kScaleLow, M);
+    scaleRow(hi, odd + 1, -kScaleHigh, M - 1);
+    scaleRow(hi + M - 1, odd, -kScaleHigh, 1);
+}
+
+// Inverse of liftRowForward; `even`/`odd` are scratch of M floats
+void liftRowInverse(const float* lo, const float* hi, int M, float* out, float* even, float* odd) {
+    scaleRow(even, lo, kScaleHigh, M);  // kScaleHigh == 1 / kScaleLow
+    scaleRow(odd + 1, hi, -kScaleLow, M - 1);
+    scaleRow(odd, hi + M - 1, -kScaleLow, 1);
+    addScaledRow(even, odd + 1, 1.0f, M - 1);
+    addScaledRow(even + M - 1, odd, 1.0f, 1);
+    addScaled2Row(odd, even, even + M - 1, kUpdate0, kUpdate1, 1);
+    addScaled2Row(odd + 1, even + 1, even, kUpdate0, kUpdate1, M - 1);
+    addScaledRow(even, odd, -kSqrt3, M);
+    mergeRow(even, odd, out, M);
+}
+
+// ---------------------------------------------------------------------------
+// Band-interleaved rows: sample n of band b is at x[n * B + b]. Each group of
+// lanes (a vector of bands, then single bands for the tail) streams once along
+// the row; the lifting state of the previous pixel pair stays in registers.
+// ---------------------------------------------------------------------------
+
+struct VecLanes {
+    using V = simd::Vec;
+    static constexpr int kCount = simd::kWidth;
+    static V load(const float* p) { return simd::load(p); }
+    static void store(float* p, V v) { simd::store(p, v); }
+    static V set1(float c) { return simd::set1(c); }
+    static V add(V a, V b) { return simd::add(a, b); }
+    static V mul(V a, V b) { return simd::mul(a, b); }
+};
+
+struct ScalarLanes {
+    using V = float;
+    static constexpr int kCount = 1;
+    static V load(const float* p) { return *p; }
+    static void store(float* p, V v) { *p = v; }
+    static V set1(float c) { return c; }
+    static V add(V a, V b) { return a + b; }
+    static V mul(V a, V b) { return a * b; }
+};
+
+// s1[k] = x[2k] + sqrt3 x[2k+1]; d1[k] = x[2k+1] - u0 s1[k] - u1 s1[k-1];
+// lo[k] = scaleLow (s1[k] - d1[k+1]); hi[k] = -scaleHigh d1[k+1] (indices mod M)
+template <class L>
+static void liftInterleavedForwardLanes(const float* x, int M, int B, float* lo, float* hi) {
+    using V = typename L::V;
+    const V sqrt3 = L::set1(kSqrt3), u0 = L::set1(-kUpdate0), u1 = L::set1(-kUpdate1), minus1 = L::set1(-1.0f);
+    const V scaleLow = L::set1(kScaleLow), scaleHigh = L::set1(-kScaleHigh);
+    auto s1At = [&](int k) { return L::add(L::load(x + 2 * k * B), L::mul(sqrt3, L::load(x + (2 * k + 1) * B))); };
+    auto d1At = [&](int k, V s, V sPrev) {
+        return L::add(L::load(x + (2 * k + 1) * B), L::add(L::mul(u0, s), L::mul(u1, sPrev)));
+    };
+    V s = s1At(0);
+    const V d0 = d1At(0, s, s1At(M - 1));
+    for (int k = 0; k < M; ++k) {
+        V sNext = s, dNext = d0;
+        if (k + 1 < M) {
+            sNext = s1At(k + 1);
+            dNext = d1At(k + 1, sNext, s);
+        }
+        L::store(lo + k * B, L::mul(scaleLow, L::add(s, L::mul(minus1, dNext))));
+        L::store(hi + k * B, L::mul(scaleHigh, dNext));
+        s = sNext;
+    }
+}
+
+// s1[k] = scaleHigh lo[k] - scaleLow hi[k]; x[2k+1] = -scaleLow hi[k-1] + u0 s1[k] + u1 s1[k-1];
+// x[2k] = s1[k] - sqrt3 x[2k+1]
+template <class L>
+static void liftInterleavedInverseLanes(const float* lo, const float* hi, int M, int B, float* out) {
+    using V = typename L::V;
+    const V sqrt3 = L::set1(-kSqrt3), u0 = L::set1(kUpdate0), u1 = L::set1(kUpdate1), one = L::set1(1.0f);
+    const V scaleLow = L::set1(-kScaleLow), scaleHigh = L::set1(kScaleHigh);
+    auto s1At = [&](int k) {
+        return L::add(L::mul(scaleHigh, L::load(lo + k * B)), L::mul(one, L::mul(scaleLow, L::load(hi + k * B))));
+    };
+    V sPrev = s1At(M - 1);
+    for (int k = 0; k < M; ++k) {
+        V s = s1At(k);
+        V d = L::mul(scaleLow, L::load(hi + ((k + M - 1) % M) * B));
+        V odd = L::add(d, L::add(L::mul(u0, s), L::mul(u1, sPrev)));
+        L::store(out + (2 * k + 1) * B, odd);
+        L::store(out + 2 * k * B, L::add(s, L::mul(sqrt3, odd)));
+        sPrev = s;
+    }
+}
+
+void liftInterleavedForward(const float* x, int N, int B, float* lo, float* hi) {
+    int M = N / 2, j = 0;
+    for (; j + VecLanes::kCount <= B; j += VecLanes::kCount)
+        liftInterleavedForwardLanes<VecLanes>(x + j, M, B, lo + j, hi + j);
+    for (; j < B; ++j)
+        liftInterleavedForwardLanes<ScalarLanes>(x + j, M, B, lo + j, hi + j);
+}
+
+void liftInterleavedInverse(const float* lo, const float* hi, int M, int B, float* out) {
+    int j = 0;
+    for (; j + VecLanes::kCount <= B; j += VecLanes::kCount)
+        liftInterleavedInverseLanes<VecLanes>(lo + j, hi + j, M, B, out + j);
+    for (; j < B; ++j)
+        liftInterleavedInverseLanes<ScalarLanes>(lo + j, hi + j, M, B, out + j);
+}
+
+// ---------------------------------------------------------------------------
+// Vertical transforms: every step combines whole rows, so a view's adjacent
+// columns are filtered together with no gather
+// ---------------------------------------------------------------------------
+
+// Convolution db4 down the columns of `in` (even rows, >= 4) into lo/hi (rows/2 each)
+void convColumnsForward(PlaneView<const float> in, PlaneView<float> lo, PlaneView<float> hi) {
+    int N = in.rows(), W = in.cols();
+    for (int k = 0; k < N / 2; ++k) {
+        const float* r0 = in.row(mirrorIndex(2 * k - 2, N));
+        const float* r1 = in.row(mirrorIndex(2 * k - 1, N));
+        const float* r2 = in.row(2 * k);
+        const float* r3 = in.row(2 * k + 1);
+        combine4Row(lo.row(k), r0, r1, r2, r3, kDb4Low, W);
+        combine4Row(hi.row(k), r0, r1, r2, r3, kDb4High, W);
+    }
+}
+
+// Inverse convolution db4 down the columns: lo/hi (M rows each) -> out (2M rows)
+void convColumnsInverse(PlaneView<const float> lo, PlaneView<const float> hi, PlaneView<float> out) {
+    int M = lo.rows(), W = lo.cols();
+    combine2Row(out.row(0), lo.row(0), hi.row(0), kDb4Low[0], kDb4High[0], W);
+    combine2Row(out.row(1), lo.row(0), hi.row(0), kDb4Low[1], kDb4High[1], W);
+    for (int m = 1; m < M; ++m) {
+        combine4Row(out.row(2 * m), lo.row(m - 1), hi.row(m - 1), lo.row(m), hi.row(m), synthEven, W);
+        combine4Row(out.row(2 * m + 1), lo.row(m - 1), hi.row(m - 1), lo.row(m), hi.row(m), synthOdd, W);
+    }
+}
+
+// Forward db4 lifting down the columns of p (modified in place), scaled results into lo/hi
+void liftColumnsForward(PlaneView<float> p, PlaneView<float> lo, PlaneView<float> hi) {
+    int M = p.rows() / 2, W = p.cols();
+    for (int k = 0; k < M; ++k)
+        addScaledRow(p.row(2 * k), p.row(2 * k + 1), kSqrt3, W);
+    for (int k = 0; k < M; ++k)
+        addScaled2Row(p.row(2 * k + 1), p.row(2 * k), p.row(2 * ((k + M - 1) % M)), -kUpdate0, -kUpdate1, W);
+    for (int k = 0; k < M; ++k)
+        addScaledRow(p.row(2 * k), p.row(2 * ((k + 1) % M) + 1), -1.0f, W);
+    for (int k = 0; k < M; ++k) {
+        scaleRow(lo.row(k), p.row(2 * k), kScaleLow, W);
+        scaleRow(hi.row(k), p.row(2 * ((k + 1) % M) + 1), -kScaleHigh, W);
+    }
+}
+
+// Inverse db4 lifting down the columns: lo/hi (M rows each) -> p (2M rows)
+void liftColumnsInverse(PlaneView<const float> lo, PlaneView<const float> hi, PlaneView<float> p) {
+    int M = lo.rows(), W = lo.cols();
+    for (int k = 0; k < M; ++k) {
+        scaleRow(p.row(2 * k), lo.row(k), kScaleHigh, W);
+        scaleRow(p.row(2 * k + 1), hi.row((k + M - 1) % M), -kScaleLow, W);
+    }
+    for (int k = 0; k < M; ++k)
+        addScaledRow(p.row(2 * k), p.row(2 * ((k + 1) % M) + 1), 1.0f, W);
+    for (int k = 0; k < M; ++k)
+        addScaled2Row(p.row(2 * k + 1), p.row(2 * k), p.row(2 * ((k + M - 1) % M)), kUpdate0, kUpdate1, W);
+    for (int k = 0; k < M; ++k)
+        addScaledRow(p.row(2 * k), p.row(2 * k + 1), -kSqrt3, W);
+}
+
+// ---------------------------------------------------------------------------
+// Reversible LeGall 5/3 (integer to integer). Floor shifts make every step
+// exactly invertible, so inverse(forward(x)) == x bit for bit.
+// ---------------------------------------------------------------------------
+
+void predict53Row(int32_t* y, const int32_t* x, const int32_t* a, const int32_t* b, int n) {
+    int j = 0;
+    for (; j + simd::kWidth <= n; j += simd::kWidth)
+        simd::storei(y + j, simd::subi(simd::loadi(x + j),
+                                       simd::srai<1>(simd::addi(simd::loadi(a + j), simd::loadi(b + j)))));
+    for (; j < n; ++j)
+        y[j] = x[j] - ((a[j] + b[j]) >> 1);
+}
+
+void unpredict53Row(int32_t* y, const int32_t* x, const int32_t* a, const int32_t* b, int n) {
+    int j = 0;
+    for (; j + simd::kWidth <= n; j += simd::kWidth)
+        simd::storei(y + j, simd::addi(simd::loadi(x + j),
+                                       simd::srai<1>(simd::addi(simd::loadi(a + j), simd::loadi(b + j)))));
+    for (; j < n; ++j)
+        y[j] = x[j] + ((a[j] + b[j]) >> 1);
+}
+
+void update53Row(int32_t* y, const int32_t* x, const int32_t* a, const int32_t* b, int n) {
+    const simd::VecI two = simd::set1i(2);
+    int j = 0;
+    for (; j + simd::kWidth <= n; j += simd::kWidth) {
+        simd::VecI t = simd::addi(simd::addi(simd::loadi(a + j), simd::loadi(b + j)), two);
+        simd::storei(y + j, simd::addi(simd::loadi(x + j), simd::srai<2>(t)));
+    }
+    for (; j < n; ++j)
+        y[j] = x[j] + ((a[j] + b[j] + 2) >> 2);
+}
+
+void unupdate53Row(int32_t* y, const int32_t* x, const int32_t* a, const int32_t* b, int n) {
+    const simd::VecI two = simd::set1i(2);
+    int j = 0;
+    for (; j + simd::kWidth <= n; j += simd::kWidth) {
+        simd::VecI t = simd::addi(simd::addi(simd::loadi(a + j), simd::loadi(b + j)), two);
+        simd::storei(y + j, simd::subi(simd::loadi(x + j), simd::srai<2>(t)));
+    }
+    for (; j < n; ++j)
+        y[j] = x[j] - ((a[j] + b[j] + 2) >> 2);
+}
+
+// Symmetric extension: x[N] mirrors to x[N-2] (the last even sample), d[-1] to d[0]
+void lift53RowForward(const int32_t* x, int N, int32_t* lo, int32_t* hi, int32_t* even, int32_t* odd) {
+    int M = N / 2;
+    for (int k = 0; k < M; ++k) {
+        even[k] = x[2 * k];
+        odd[k] = x[2 * k + 1];
+    }
+    predict53Row(hi, odd, even, even + 1, M - 1);
+    hi[M - 1] = odd[M - 1] - even[M - 1];
+    lo[0] = even[0] + ((2 * hi[0] + 2) >> 2);
+    update53Row(lo + 1, even + 1, hi, hi + 1, M - 1);
+}
+
+void lift53RowInverse(const int32_t* lo, const int32_t* hi, int M, int32_t* out, int32_t* even, int32_t* odd) {
+    even[0] = lo[0] - ((2 * hi[0] + 2) >> 2);
+    unupdate53Row(even + 1, lo + 1, hi, hi + 1, M - 1);
+    unpredict53Row(odd, hi, even, even + 1, M - 1);
+    odd[M - 1] = hi[M - 1] + even[M - 1];
+    for (int k = 0; k < M; ++k) {
+        out[2 * k] = even[k];
+        out[2 * k + 1] = odd[k];
+    }
+}
+
+void lift53ColumnsForward(PlaneView<const int32_t> in, PlaneView<int32_t> lo, PlaneView<int32_t> hi) {
+    int M = in.rows() / 2, W = in.cols();
+    for (int k = 0; k < M; ++k)
+        predict53Row(hi.row(k), in.row(2 * k + 1), in.row(2 * k), in.row(std::min(2 * k + 2, 2 * M - 2)), W);
+    for (int k = 0; k < M; ++k)
+        update53Row(lo.row(k), in.row(2 * k), hi.row(std::max(k - 1, 0)), hi.row(k), W);
+}
+
+void lift53ColumnsInverse(PlaneView<const int32_t> lo, PlaneView<const int32_t> hi, PlaneView<int32_t> out) {
+    int M = lo.rows(), W = lo.cols();
+    for (int k = 0; k < M; ++k)
+        unupdate53Row(out.row(2 * k), lo.row(k), hi.row(std::max(k - 1, 0)), hi.row(k), W);
+    for (int k = 0; k < M; ++k)
+        unpredict53Row(out.row(2 * k + 1), hi.row(k), out.row(2 * k), out.row(std::min(2 * k + 2, 2 * M - 2)), W);
+}
+
+}  // namespace dwt_kernels
@@ -0,0 +1,787 @@
+#include "dwt_plan.hpp"
+#include "dwt_kernels.hpp"
+#include "filter_bank.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+using namespace dwt_kernels;
+
+// DC gain of every float low-pass (taps sum to sqrt(2)). The last sample of an odd-length
+// row or column skips the filter and is carried into the low band scaled by this, so it
+// sits at the same level as its filtered neighbours.
+static const float kOddGain = 1.4142135624f;
+static const float kOddGainInv = 0.7071067812f;
+
+// Row and column kernels of one filter, all working in caller-provided scratch
+struct DwtKernelSet {
+    void (*rowForward)(const float* x, int N, float* lo, float* hi, float* scratch);
+    void (*rowInverse)(const float* lo, const float* hi, int M, float* out, float* scratch);
+    void (*columnsForward)(PlaneView<float> tile, PlaneView<float> lo, PlaneView<float> hi);  // tile may be clobbered
+    void (*columnsInverse)(PlaneView<const float> lo, PlaneView<const float> hi, PlaneView<float> out);
+    // Band-interleaved rows: N pixels of B samples each (x may be clobbered)
+    void (*rowForwardInterleaved)(float* x, int N, int B, float* lo, float* hi);
+    void (*rowInverseInterleaved)(const float* lo, const float* hi, int M, int B, float* out);
+    int (*rowScratch)(int M);  // scratch floats the row kernels need for M samples per band
+    int regionMargin;          // coefficients each side an inverse output depends on (-1: not periodic)
+};
+
+// db4 kernels adapted to the single-scratch signatures
+static void liftRowForwardS(const float* x, int N, float* lo, float* hi, float* scratch) {
+    liftRowForward(x, N, lo, hi, scratch);
+}
+static void liftRowInverseS(const float* lo, const float* hi, int M, float* out, float* scratch) {
+    liftRowInverse(lo, hi, M, out, scratch, scratch + M);
+}
+static void convRowForwardS(const float* x, int N, float* lo, float* hi, float* scratch) {
+    convRowForward(x, N, lo, hi, scratch, scratch + N / 2 + 1);
+}
+static void convRowInverseS(const float* lo, const float* hi, int M, float* out, float* scratch) {
+    convRowInverse(lo, hi, M, out, scratch, scratch + M);
+}
+static void convColumnsForwardS(PlaneView<float> tile, PlaneView<float> lo, PlaneView<float> hi) {
+    convColumnsForward(tile, lo, hi);
+}
+static void liftRowForwardInterleavedS(float* x, int N, int B, float* lo, float* hi) {
+    liftInterleavedForward(x, N, B, lo, hi);
+}
+
+// Filters without a dedicated interleaved kernel treat the BIP row as an N x B tile,
+// so the column kernel filters along the row with one lane per band
+template <void (*Columns)(PlaneView<float>, PlaneView<float>, PlaneView<float>)>
+static void columnRowForwardInterleaved(float* x, int N, int B, float* lo, float* hi) {
+    Columns(PlaneView<float>(x, N, B, B), PlaneView<float>(lo, N / 2, B, B), PlaneView<float>(hi, N / 2, B, B));
+}
+template <void (*Columns)(PlaneView<const float>, PlaneView<const float>, PlaneView<float>)>
+static void columnRowInverseInterleaved(const float* lo, const float* hi, int M, int B, float* out) {
+    Columns(PlaneView<const float>(lo, M, B, B), PlaneView<const float>(hi, M, B, B), PlaneView<float>(out, 2 * M, B, B));
+}
+
+static int db4RowScratch(int M) {
+    return 2 * (M + 1);
+}
+
+static const DwtKernelSet kLiftingKernels = {
+    liftRowForwardS, liftRowInverseS, liftColumnsForward, liftColumnsInverse,
+    liftRowForwardInterleavedS, liftInterleavedInverse, db4RowScratch, 2
+};
+// Symmetric extension does not wrap, so region decoding is not offered for it
+static const DwtKernelSet kConvolutionKernels = {
+    convRowForwardS, convRowInverseS, convColumnsForwardS, convColumnsInverse,
+    columnRowForwardInterleaved<convColumnsForwardS>, columnRowInverseInterleaved<convColumnsInverse>, db4RowScratch, -1
+};
+
+template <class FB>
+static void bankColumnsForward(PlaneView<float> tile, PlaneView<float> lo, PlaneView<float> hi) {
+    filterColumnsForward<FB>(tile, lo, hi);
+}
+
+// One kernel set per filter bank instantiation
+template <class FB>
+static const DwtKernelSet kBankKernels = {
+    filterRowForward<FB>, filterRowInverse<FB>, bankColumnsForward<FB>, filterColumnsInverse<FB>,
+    columnRowForwardInterleaved<bankColumnsForward<FB>>, columnRowInverseInterleaved<filterColumnsInverse<FB>>,
+    filterRowScratch<FB>, Polyphase<FB>::kMargin
+};
+
+static const DwtKernelSet* kernelsFor(Wavelet wavelet) {
+    using namespace filter_banks;
+    switch (wavelet) {
+        case Wavelet::Db2:      return &kBankKernels<Daubechies<2>>;
+        case Wavelet::Db4:      return &kBankKernels<Daubechies<4>>;
+        case Wavelet::Db6:      return &kBankKernels<Daubechies<6>>;
+        case Wavelet::Db8:      return &kBankKernels<Daubechies<8>>;
+        case Wavelet::Db10:     return &kBankKernels<Daubechies<10>>;
+        case Wavelet::Db12:     return &kBankKernels<Daubechies<12>>;
+        case Wavelet::Db14:     return &kBankKernels<Daubechies<14>>;
+        case Wavelet::Db16:     return &kBankKernels<Daubechies<16>>;
+        case Wavelet::Db18:     return &kBankKernels<Daubechies<18>>;
+        case Wavelet::Db20:     return &kBankKernels<Daubechies<20>>;
+        case Wavelet::Cdf97:    return &kBankKernels<Cdf97>;
+        case Wavelet::LeGall53: return &kBankKernels<LeGall53>;
+    }
+    return nullptr;
+}
+
+static const char* const kWaveletNames[] = {
+    "db2", "db4", "db6", "db8", "db10", "db12", "db14", "db16", "db18", "db20", "cdf97", "legall53"
+};
+
+const char* waveletName(Wavelet wavelet) {
+    return kWaveletNames[static_cast<int>(wavelet)];
+}
+
+bool parseWavelet(const std::string& name, Wavelet& wavelet) {
+    for (int i = 0; i <= static_cast<int>(Wavelet::LeGall53); ++i) {
+        if (name == kWaveletNames[i]) {
+            wavelet = static_cast<Wavelet>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+DwtPlan::DwtPlan(int rows, int cols, int levels, DwtMethod method, ThreadPool* pool, int bands) {
+    init(rows, cols, levels, bands, method == DwtMethod::Lifting ? &kLiftingKernels : &kConvolutionKernels, pool);
+}
+
+DwtPlan::DwtPlan(int rows, int cols, int levels, Wavelet wavelet, ThreadPool* pool, int bands) {
+    init(rows, cols, levels, bands, kernelsFor(wavelet), pool);
+}
+
+void DwtPlan::init(int rows, int cols, int levels, int bands, const DwtKernelSet* kernels, ThreadPool* pool) {
+    rows_ = rows;
+    cols_ = cols;
+    levels_ = levels;
+    bands_ = bands;
+    kernels_ = kernels;
+    pool_ = pool;
+    valid_ = kernels && bands >= 1 && pyramidShapeOk(rows, cols, levels);
+    if (!valid_) {
+        std::cerr << "Error: " << rows << "x" << cols << " cannot be decomposed into "
+                  << levels << " levels (every level must be at least 4x4)." << std::endl;
+        return;
+    }
+
+    // Position and symbol offset of every subband in coding order
+    codingIndex_.assign(levels * 4, 0);
+    symbolOffset_.assign(levels * 4, 0);
+    std::ptrdiff_t offset = 0;
+    int index = 0;
+    for (const auto& [level, band] : pyramidCodingOrder(levels)) {
+        int slot = (level - 1) * 4 + static_cast<int>(band);
+        codingIndex_[slot] = index++;
+        symbolOffset_[slot] = offset;
+        int h = pyramidExtent(rows, level - 1), w = pyramidExtent(cols, level - 1);
+        bool lowRows = band == Subband::LL || band == Subband::LH;
+        bool lowCols = band == Subband::LL || band == Subband::HL;
+        offset += static_cast<std::ptrdiff_t>(lowRows ? (h + 1) / 2 : h / 2) * (lowCols ? (w + 1) / 2 : w / 2);
+    }
+
+    // One slot per thread; each pass hands every slot a fixed share of the rows or tiles
+    int threads = pool ? pool->size() : 1;
+    slots_.resize(threads);
+    for (Slot& slot : slots_) {
+        slot.line.resize(static_cast<size_t>(cols) * bands);
+        slot.scratch.resize(kernels->rowScratch(cols / 2));
+        slot.tile.resize(rows, std::min(kInPlaceTile, cols * bands));
+        slot.result.resize(cols);
+    }
+}
+
+bool DwtPlan::shapeMatches(PlaneView<float> p) const {
+    if (valid_ && p.rows() == rows_ && p.cols() == cols_ * bands_) return true;
+    std::cerr << "Error: DWT plan for " << rows_ << "x" << cols_ << "x" << bands_ << " (" << levels_
+              << " levels) applied to " << p.rows() << "x" << p.cols() << "." << std::endl;
+    return false;
+}
+
+// The quantizing, 8-bit, progressive and region paths work on one band at a time
+bool DwtPlan::singleBand() const {
+    if (bands_ == 1) return true;
+    std::cerr << "Error: a band-interleaved DWT plan only supports forward() and inverse()." << std::endl;
+    return false;
+}
+
+// Rows become [L | H]; an odd row filters its even part and carries the last sample to the end of L
+void DwtPlan::rowsForward(int s) {
+    Slot& slot = slots_[s];
+    int h = block_.rows(), w = block_.cols() / bands_, slots = static_cast<int>(slots_.size());
+    int lowW = (w + 1) / 2, B = bands_;
+    for (int i = h * s / slots; i < h * (s + 1) / slots; ++i) {
+        float* row = block_.row(i);
+        std::copy(row, row + w * B, slot.line.begin());
+        if (B == 1) {
+            kernels_->rowForward(slot.line.data(), w & ~1, row, row + lowW, slot.scratch.data());
+        } else {
+            kernels_->rowForwardInterleaved(slot.line.data(), w & ~1, B, row, row + lowW * B);
+        }
+        if (w & 1)
+            scaleRow(row + (lowW - 1) * B, slot.line.data() + (w - 1) * B, kOddGain, B);
+    }
+}
+
+void DwtPlan::rowsInverse(int s) {
+    Slot& slot = slots_[s];
+    int h = block_.rows(), w = block_.cols() / bands_, slots = static_cast<int>(slots_.size());
+    int lowW = (w + 1) / 2, B = bands_;
+    bool toPixels = level_ == 1 && !pixels_.empty();
+    slot.minV = std::numeric_limits<float>::max();
+    slot.maxV = std::numeric_limits<float>::lowest();
+    for (int i = h * s / slots; i < h * (s + 1) / slots; ++i) {
+        float* row = block_.row(i);
+        std::copy(row, row + w * B, slot.line.begin());
+        if (B > 1) {
+            kernels_->rowInverseInterleaved(slot.line.data(), slot.line.data() + lowW * B, w / 2, B, row);
+            if (w & 1)
+                scaleRow(row + (w - 1) * B, slot.line.data() + (lowW - 1) * B, kOddGainInv, B);
+            continue;
+        }
+        // Last stage of an 8-bit reconstruction: clamp straight into the pixels, or keep the
+        // floats and track the range for the Normalize mapping pass
+        float* result = toPixels && mapping_ == PixelMapping::Clamp ? slot.result.data() : row;
+        kernels_->rowInverse(slot.line.data(), slot.line.data() + lowW, w / 2, result, slot.scratch.data());
+        if (w & 1)
+            result[w - 1] = slot.line[lowW - 1] * kOddGainInv;
+        if (!toPixels)
+            continue;
+        if (mapping_ == PixelMapping::Clamp) {
+            uint8_t* px = pixels_.row(i);
+            for (int j = 0; j < w; ++j)
+                px[j] = static_cast<uint8_t>(std::clamp(std::round(result[j]), 0.0f, 255.0f));
+        } else {
+            for (int j = 0; j < w; ++j) {
+                slot.minV = std::min(slot.minV, result[j]);
+                slot.maxV = std::max(slot.maxV, result[j]);
+            }
+        }
+    }
+}
+
+// Normalize mapping of this slot's rows of the finished reconstruction to [0, 255]
+void DwtPlan::mapPixels(int s) {
+    int slots = static_cast<int>(slots_.size());
+    float minV = normalizeMin_, maxV = normalizeMax_;
+    float scale = maxV > minV ? 255.0f / (maxV - minV) : 0.0f;
+    for (int i = rows_ * s / slots; i < rows_ * (s + 1) / slots; ++i) {
+        const float* row = block_.row(i);
+        uint8_t* px = pixels_.row(i);
+        for (int j = 0; j < cols_; ++j)
+            px[j] = static_cast<uint8_t>(std::clamp(std::round((row[j] - minV) * scale), 0.0f, 255.0f));
+    }
+}
+
+void DwtPlan::columnsForward(int s) {
+    Slot& slot = slots_[s];
+    int h = block_.rows(), w = block_.cols(), slots = static_cast<int>(slots_.size());
+    for (int c0 = s * tileWidth_; c0 < w; c0 += slots * tileWidth_) {
+        int tw = std::min(tileWidth_, w - c0);
+        PlaneView<float> tile = slot.tile.view().sub(0, 0, h, tw);
+        for (int i = 0; i < h; ++i)
+            std::copy(block_.row(i) + c0, block_.row(i) + c0 + tw, tile.row(i));
+        int lowH = (h + 1) / 2;
+        kernels_->columnsForward(tile.sub(0, 0, h & ~1, tw), block_.sub(0, c0, h / 2, tw),
+                                 block_.sub(lowH, c0, h / 2, tw));
+        if (h & 1)
+            scaleRow(block_.row(lowH - 1) + c0, tile.row(h - 1), kOddGain, tw);
+        if (symbols_)
+            emitSymbols(c0, tw);
+    }
+}
+
+// Quantizes the parts of columns [c0, c0 + tw) of the current level that are now final
+// (LH, HL, HH, and LL at the last level) into their slots of the symbol buffer
+void DwtPlan::emitSymbols(int c0, int tw) {
+    int h = block_.rows(), w = block_.cols();
+    int lowH = (h + 1) / 2, lowW = (w + 1) / 2;
+    auto emit = [&](Subband band, int r0, int bandRows, int bandCol0, int bandCols, int from, int to) {
+        if (from >= to) return;
+        int slot = (level_ - 1) * 4 + static_cast<int>(band);
+        float q = steps_[codingIndex_[slot]];
+        int* out = symbols_ + symbolOffset_[slot] + (from - bandCol0);
+        for (int i = 0; i < bandRows; ++i, out += bandCols) {
+            const float* row = block_.row(r0 + i);
+            for (int j = from; j < to; ++j)
+                out[j - from] = static_cast<int>(std::round(row[j] / q));
+        }
+    };
+    int end = c0 + tw;
+    int leftEnd = std::min(end, lowW), rightStart = std::max(c0, lowW);
+    if (level_ == levels_)
+        emit(Subband::LL, 0, lowH, 0, lowW, c0, leftEnd);
+    emit(Subband::LH, 0, lowH, lowW, w - lowW, rightStart, end);
+    emit(Subband::HL, lowH, h - lowH, 0, lowW, c0, leftEnd);
+    emit(Subband::HH, lowH, h - lowH, lowW, w - lowW, rightStart, end);
+}
+
+void DwtPlan::columnsInverse(int s) {
+    Slot& slot = slots_[s];
+    int h = block_.rows(), w = block_.cols(), slots = static_cast<int>(slots_.size());
+    for (int c0 = s * tileWidth_; c0 < w; c0 += slots * tileWidth_) {
+        int tw = std::min(tileWidth_, w - c0);
+        PlaneView<float> tile = slot.tile.view().sub(0, 0, h, tw);
+        if (inSymbols_) {
+            loadTile(tile, c0, tw);
+        } else {
+            for (int i = 0; i < h; ++i)
+                std::copy(block_.row(i) + c0, block_.row(i) + c0 + tw, tile.row(i));
+        }
+        int lowH = (h + 1) / 2;
+        kernels_->columnsInverse(tile.sub(0, 0, h / 2, tw), tile.sub(lowH, 0, h / 2, tw),
+                                 block_.sub(0, c0, h & ~1, tw));
+        if (h & 1)
+            scaleRow(block_.row(h - 1) + c0, tile.row(lowH - 1), kOddGainInv, tw);
+    }
+}
+
+// Fills a column tile of the current level for inverseDequantized*: the LL quadrant of a
+// finer level is the reconstruction left in the block by the level above, everything else
+// is dequantized straight from the symbol buffer
+void DwtPlan::loadTile(PlaneView<float> tile, int c0, int tw) {
+    int h = block_.rows(), w = block_.cols();
+    int lowH = (h + 1) / 2, lowW = (w + 1) / 2;
+    auto load = [&](Subband band, int r0, int bandRows, int bandCol0, int bandCols, int from, int to) {
+        if (from >= to) return;
+        int slot = (level_ - 1) * 4 + static_cast<int>(band);
+        float q = steps_[codingIndex_[slot]];
+        const int* in = inSymbols_ + symbolOffset_[slot] + (from - bandCol0);
+        for (int i = 0; i < bandRows; ++i, in += bandCols) {
+            float* dst = tile.row(r0 + i) + (from - c0);
+            for (int j = 0; j < to - from; ++j)
+                dst[j] = in[j] * q;
+        }
+    };
+    int end = c0 + tw;
+    int leftEnd = std::min(end, lowW), rightStart = std::max(c0, lowW);
+    if (level_ == levels_) {
+        load(Subband::LL, 0, lowH, 0, lowW, c0, leftEnd);
+    } else if (c0 < leftEnd) {
+        for (int i = 0; i < lowH; ++i)
+            std::copy(block_.row(i) + c0, block_.row(i) + leftEnd, tile.row(i));
+    }
+    load(Subband::LH, 0, lowH, lowW, w - lowW, rightStart, end);
+    load(Subband::HL, lowH, h - lowH, 0, lowW, c0, leftEnd);
+    load(Subband::HH, lowH, h - lowH, lowW, w - lowW, rightStart, end);
+}
+
+// Each level: rows become [L | H], then columns become [L ; H], on the shrinking top-left block
+bool DwtPlan::forward(PlaneView<float> image) {
+    if (!shapeMatches(image)) return false;
+    int slots = static_cast<int>(slots_.size());
+    for (int l = 0; l < levels_; ++l) {
+        block_ = image.sub(0, 0, pyramidExtent(rows_, l), pyramidExtent(cols_, l) * bands_);
+        tileWidth_ = std::min(kInPlaceTile, columnTileWidth(block_.cols(), pool_));
+        level_ = l + 1;
+        forEachPart(pool_, slots, [this](int s) { rowsForward(s); });
+        forEachPart(pool_, slots, [this](int s) { columnsForward(s); });
+    }
+    return true;
+}
+
+bool DwtPlan::forwardQuantized(PlaneView<float> image, const float* steps, int* symbols) {
+    if (!singleBand()) return false;
+    steps_ = steps;
+    symbols_ = symbols;
+    bool ok = forward(image);
+    steps_ = nullptr;
+    symbols_ = nullptr;
+    return ok;
+}
+
+bool DwtPlan::inverse(PlaneView<float> coeffs) {
+    return shapeMatches(coeffs) && runInverse(coeffs);
+}
+
+// Inverts levels `levels` down to stopLevel + 1, leaving LL of level stopLevel in the block
+bool DwtPlan::runInverse(PlaneView<float> coeffs, int stopLevel) {
+    int slots = static_cast<int>(slots_.size());
+    for (int l = levels_ - 1; l >= stopLevel; --l) {
+        block_ = coeffs.sub(0, 0, pyramidExtent(rows_, l), pyramidExtent(cols_, l) * bands_);
+        tileWidth_ = std::min(kInPlaceTile, columnTileWidth(block_.cols(), pool_));
+        level_ = l + 1;
+        forEachPart(pool_, slots, [this](int s) { columnsInverse(s); });
+        forEachPart(pool_, slots, [this](int s) { rowsInverse(s); });
+    }
+    return true;
+}
+
+bool DwtPlan::inverseDequantized(const int* symbols, const float* steps, PlaneView<float> out) {
+    if (!singleBand() || !shapeMatches(out)) return false;
+    inSymbols_ = symbols;
+    steps_ = steps;
+    bool ok = runInverse(out);
+    inSymbols_ = nullptr;
+    steps_ = nullptr;
+    return ok;
+}
+
+bool DwtPlan::inverseDequantized8(const int* symbols, const float* steps, PlaneView<float> work,
+                                  PlaneView<uint8_t> out, PixelMapping mapping) {
+    if (!singleBand() || !shapeMatches(work)) return false;
+    if (out.rows() != rows_ || out.cols() != cols_) {
+        std::cerr << "Error: 8-bit output is " << out.rows() << "x" << out.cols() << ", plan is "
+                  << rows_ << "x" << cols_ << "." << std::endl;
+        return false;
+    }
+    inSymbols_ = symbols;
+    steps_ = steps;
+    pixels_ = out;
+    mapping_ = mapping;
+    bool ok = runInverse(work);
+    if (ok && mapping == PixelMapping::Normalize) {
+        float minV = slots_[0].minV, maxV = slots_[0].maxV;
+        for (const Slot& slot : slots_) {
+            minV = std::min(minV, slot.minV);
+            maxV = std::max(maxV, slot.maxV);
+        }
+        normalizeMin_ = minV;
+        normalizeMax_ = maxV;
+        forEachPart(pool_, static_cast<int>(slots_.size()), [this](int s) { mapPixels(s); });
+    }
+    inSymbols_ = nullptr;
+    steps_ = nullptr;
+    pixels_ = PlaneView<uint8_t>();
+    return ok;
+}
+
+std::size_t DwtPlan::approximationSymbols(int level) const {
+    if (level <= 0) return static_cast<std::size_t>(rows_) * cols_;
+    // Everything before the details of `level` in coding order, i.e. the LL of `level` itself
+    return static_cast<std::size_t>(pyramidExtent(rows_, std::min(level, levels_))) *
+           pyramidExtent(cols_, std::min(level, levels_));
+}
+
+bool DwtPlan::inverseApproximation(const int* symbols, const float* steps, int level, PlaneView<float> out) {
+    if (!singleBand()) return false;
+    if (!valid_ || level < 0 || level > levels_) {
+        std::cerr << "Error: approximation level " << level << " outside 0.." << levels_ << "." << std::endl;
+        return false;
+    }
+    int h = pyramidExtent(rows_, level), w = pyramidExtent(cols_, level);
+    if (out.rows() != h || out.cols() != w) {
+        std::cerr << "Error: level " << level << " approximation is " << h << "x" << w << ", output is "
+                  << out.rows() << "x" << out.cols() << "." << std::endl;
+        return false;
+    }
+    if (level == levels_) {
+        // The coarsest LL needs no inverse step at all
+        for (int i = 0; i < h; ++i)
+            for (int j = 0; j < w; ++j)
+                out(i, j) = symbols[static_cast<std::ptrdiff_t>(i) * w + j] * steps[0];
+    } else {
+        inSymbols_ = symbols;
+        steps_ = steps;
+        runInverse(out, level);
+        inSymbols_ = nullptr;
+        steps_ = nullptr;
+    }
+    if (level > 0) {
+        for (int i = 0; i < h; ++i)
+            scaleRow(out.row(i), out.row(i), 1.0f / static_cast<float>(1 << level), w);
+    }
+    return true;
+}
+
+// Spans of one axis of a region level: runs of wanted outputs in the filtered (even) part,
+// each widened by the filter margin (or the whole band once that is no smaller), plus the
+// odd last sample when it is wanted
+DwtPlan::RegionAxis DwtPlan::planRegionAxis(const std::vector<int>& wanted, int n) const {
+    RegionAxis axis;
+    int M = n / 2, margin = kernels_->regionMargin;
+    for (size_t i = 0; i < wanted.size() && wanted[i] < 2 * M;) {
+        size_t j = i + 1;
+        while (j < wanted.size() && wanted[j] == wanted[j - 1] + 1 && wanted[j] < 2 * M) ++j;
+        int out0 = wanted[i], out1 = wanted[j - 1] + 1;
+        int k0 = out0 / 2 - margin, count = (out1 - 1) / 2 + margin + 1 - k0;
+        if (count >= M) {
+            axis.spans.assign(1, RegionSpan{ 0, 2 * M, 0, M, false });
+            break;
+        }
+        axis.spans.push_back(RegionSpan{ out0, out1, k0, count, false });
+        i = j;
+    }
+    for (const RegionSpan& span : axis.spans)
+        for (int t = 0; t < span.count; ++t)
+            axis.high.push_back(((span.k0 + t) % M + M) % M);
+    std::sort(axis.high.begin(), axis.high.end());
+    axis.high.erase(std::unique(axis.high.begin(), axis.high.end()), axis.high.end());
+    axis.low = axis.high;
+    if ((n & 1) && !wanted.empty() && wanted.back() == n - 1) {
+        axis.spans.push_back(RegionSpan{ n - 1, n, M, 1, true });
+        axis.low.push_back(M);
+    }
+    return axis;
+}
+
+DwtPlan::RegionBand DwtPlan::regionBand(int level, Subband band) const {
+    if (!inSymbols_) {
+        PlaneView<const float> sub = pyramidSubband(regionCoeffs_, level, band);
+        return RegionBand{ sub.data(), sub.stride(), nullptr, 0.0f };
+    }
+    int slot = (level - 1) * 4 + static_cast<int>(band);
+    int w = pyramidExtent(cols_, level - 1);
+    int bandCols = band == Subband::LL || band == Subband::HL ? (w + 1) / 2 : w / 2;
+    return RegionBand{ nullptr, bandCols, inSymbols_ + symbolOffset_[slot], steps_[codingIndex_[slot]] };
+}
+
+// Plans every level from the window outwards (the low indices one level needs are the outputs
+// the next coarser level must produce), then inverts from the coarsest level back down. Each
+// level keeps its outputs in a compact plane over just the wanted rows and columns.
+bool DwtPlan::runRegion(int r0, int c0, PlaneView<float> out, long long* coefficientsRead) {
+    if (!valid_ || !singleBand()) return false;
+    if (kernels_->regionMargin < 0) {
+        std::cerr << "Error: region decoding needs a periodic DWT (lifting or a filter bank)." << std::endl;
+        return false;
+    }
+    if (out.empty() || r0 < 0 || c0 < 0 || r0 + out.rows() > rows_ || c0 + out.cols() > cols_) {
+        std::cerr << "Error: window " << out.rows() << "x" << out.cols() << " at (" << r0 << ", " << c0
+                  << ") is outside the " << rows_ << "x" << cols_ << " image." << std::endl;
+        return false;
+    }
+
+    // wantedRows[l] / wantedCols[l]: outputs needed from level l + 1 (level 0 = the window)
+    std::vector<std::vector<int>> wantedRows(levels_ + 1), wantedCols(levels_ + 1);
+    std::vector<RegionAxis> rowAxes(levels_), colAxes(levels_);
+    for (int i = 0; i < out.rows(); ++i) wantedRows[0].push_back(r0 + i);
+    for (int j = 0; j < out.cols(); ++j) wantedCols[0].push_back(c0 + j);
+    long long read = 0;
+    for (int l = 0; l < levels_; ++l) {
+        rowAxes[l] = planRegionAxis(wantedRows[l], pyramidExtent(rows_, l));
+        colAxes[l] = planRegionAxis(wantedCols[l], pyramidExtent(cols_, l));
+        wantedRows[l + 1] = rowAxes[l].low;
+        wantedCols[l + 1] = colAxes[l].low;
+        const RegionAxis& ra = rowAxes[l];
+        const RegionAxis& ca = colAxes[l];
+        read += static_cast<long long>(ra.low.size()) * ca.high.size() + static_cast<long long>(ra.high.size()) * ca.low.size()
+                + static_cast<long long>(ra.high.size()) * ca.high.size();
+    }
+    read += static_cast<long long>(wantedRows[levels_].size()) * wantedCols[levels_].size();
+    if (coefficientsRead) *coefficientsRead = read;
+
+    // Position of every wanted output in its level's compact plane (-1: not kept)
+    auto positions = [](const std::vector<int>& wanted, int n) {
+        std::vector<int> pos(n, -1);
+        for (size_t i = 0; i < wanted.size(); ++i) pos[wanted[i]] = static_cast<int>(i);
+        return pos;
+    };
+
+    Plane<float> coarser;
+    std::vector<int> coarserRowPos, coarserColPos;
+    std::vector<float> line, scratch;
+    for (int l = levels_ - 1; l >= 0; --l) {
+        const int level = l + 1;
+        const int h = pyramidExtent(rows_, l), w = pyramidExtent(cols_, l);
+        const int Mr = h / 2, Mc = w / 2;
+        const RegionBand bands[4] = { regionBand(level, Subband::LL), regionBand(level, Subband::LH),
+                                      regionBand(level, Subband::HL), regionBand(level, Subband::HH) };
+        const bool llFromCoarser = level < levels_;
+        std::vector<int> rowPos = positions(wantedRows[l], h), colPos = positions(wantedCols[l], w);
+        Plane<float> result(static_cast<int>(wantedRows[l].size()), static_cast<int>(wantedCols[l].size()));
+
+        for (const RegionSpan& rs : rowAxes[l].spans) {
+            for (const RegionSpan& cs : colAxes[l].spans) {
+                const int tr = rs.carry ? 1 : 2 * rs.count, tc = cs.carry ? 1 : 2 * cs.count;
+
+                // Gather [L ; H] rows x [L | H] columns of this span pair, wrapping at the borders
+                Plane<float> tile(tr, tc);
+                for (int r = 0; r < tr; ++r) {
+                    bool lowRow = rs.carry || r < rs.count;
+                    int i = rs.carry ? Mr : ((rs.k0 + r % rs.count) % Mr + Mr) % Mr;
+                    float* dst = tile.row(r);
+                    for (int c = 0; c < tc; ++c) {
+                        bool lowCol = cs.carry || c < cs.count;
+                        int j = cs.carry ? Mc : ((cs.k0 + c % cs.count) % Mc + Mc) % Mc;
+                        int band = (lowRow ? 0 : 2) + (lowCol ? 0 : 1);
+                        dst[c] = band == 0 && llFromCoarser ? coarser(coarserRowPos[i], coarserColPos[j])
+                                                            : bands[band].at(i, j);
+                    }
+                }
+
+                // Inverse columns, then rows, exactly as runInverse does for the whole level
+                Plane<float> rowsDone(rs.carry ? 1 : 2 * rs.count, tc);
+                if (rs.carry)
+                    scaleRow(rowsDone.row(0), tile.row(0), kOddGainInv, tc);
+                else
+                    kernels_->columnsInverse(tile.view().sub(0, 0, rs.count, tc),
+                                             tile.view().sub(rs.count, 0, rs.count, tc), rowsDone);
+                const int outCols = cs.carry ? 1 : 2 * cs.count;
+                line.resize(outCols);
+                scratch.resize(kernels_->rowScratch(cs.count));
+                for (int r = 0; r < rowsDone.rows(); ++r) {
+                    int u = rs.carry ? h - 1 : 2 * rs.k0 + r;
+                    if (u < rs.out0 || u >= rs.out1) continue;  // filter margin, not exact
+                    int pr = rowPos[rs.carry ? u : (u % (2 * Mr) + 2 * Mr) % (2 * Mr)];
+                    if (pr < 0) continue;
+                    if (cs.carry)
+                        line[0] = rowsDone(r, 0) * kOddGainInv;
+                    else
+                        kernels_->rowInverse(rowsDone.row(r), rowsDone.row(r) + cs.count, cs.count,
+                                             line.data(), scratch.data());
+                    for (int c = 0; c < outCols; ++c) {
+                        int v = cs.carry ? w - 1 : 2 * cs.k0 + c;
+                        if (v < cs.out0 || v >= cs.out1) continue;
+                        int pc = colPos[cs.carry ? v : (v % (2 * Mc) + 2 * Mc) % (2 * Mc)];
+                        if (pc >= 0) result(pr, pc) = line[c];
+                    }
+                }
+            }
+        }
+        coarser = std::move(result);
+        coarserRowPos = std::move(rowPos);
+        coarserColPos = std::move(colPos);
+    }
+
+    for (int i = 0; i < out.rows(); ++i)
+        std::copy(coarser.row(i), coarser.row(i) + out.cols(), out.row(i));
+    return true;
+}
+
+bool DwtPlan::inverseRegion(PlaneView<const float> coeffs, int r0, int c0, PlaneView<float> out,
+                            long long* coefficientsRead) {
+    if (coeffs.rows() != rows_ || coeffs.cols() != cols_) {
+        std::cerr << "Error: DWT plan for " << rows_ << "x" << cols_ << " applied to "
+                  << coeffs.rows() << "x" << coeffs.cols() << "." << std::endl;
+        return false;
+    }
+    regionCoeffs_ = coeffs;
+    bool ok = runRegion(r0, c0, out, coefficientsRead);
+    regionCoeffs_ = PlaneView<const float>();
+    return ok;
+}
+
+bool DwtPlan::inverseRegionDequantized(const int* symbols, const float* steps, int r0, int c0,
+                                       PlaneView<float> out, long long* coefficientsRead) {
+    inSymbols_ = symbols;
+    steps_ = steps;
+    bool ok = runRegion(r0, c0, out, coefficientsRead);
+    inSymbols_ = nullptr;
+    steps_ = nullptr;
+    return ok;
+}
+
+// N-level in-place DWT
+bool dwtPyramid(PlaneView<float> image, int levels, DwtMethod method, ThreadPool* pool) {
+    DwtPlan plan(image.rows(), image.cols(), levels, method, pool);
+    return plan.valid() && plan.forward(image);
+}
+
+// N-level in-place inverse DWT
+bool idwtPyramid(PlaneView<float> coeffs, int levels, DwtMethod method, ThreadPool* pool) {
+    DwtPlan plan(coeffs.rows(), coeffs.cols(), levels, method, pool);
+    return plan.valid() && plan.inverse(coeffs);
+}
+
+bool dwtPyramid(PlaneView<float> image, int levels, Wavelet wavelet, ThreadPool* pool) {
+    DwtPlan plan(image.rows(), image.cols(), levels, wavelet, pool);
+    return plan.valid() && plan.forward(image);
+}
+
+bool idwtPyramid(PlaneView<float> coeffs, int levels, Wavelet wavelet, ThreadPool* pool) {
+    DwtPlan plan(coeffs.rows(), coeffs.cols(), levels, wavelet, pool);
+    return plan.valid() && plan.inverse(coeffs);
+}
+
+Dwt53Plan::Dwt53Plan(int rows, int cols, int levels, ThreadPool* pool)
+    : pool_(pool), rows_(rows), cols_(cols), levels_(levels) {
+    valid_ = pyramidShapeOk(rows, cols, levels);
+    if (!valid_) {
+        std::cerr << "Error: " << rows << "x" << cols << " cannot be decomposed into "
+                  << levels << " levels (every level must be at least 4x4)." << std::endl;
+        return;
+    }
+    int threads = pool ? pool->size() : 1;
+    slots_.resize(threads);
+    for (Slot& slot : slots_) {
+        slot.line.resize(cols);
+        slot.even.resize(cols / 2);
+        slot.odd.resize(cols / 2);
+        slot.tile.resize(rows, std::min(kInPlaceTile, cols));
+    }
+}
+
+bool Dwt53Plan::shapeMatches(PlaneView<int32_t> p) const {
+    if (valid_ && p.rows() == rows_ && p.cols() == cols_) return true;
+    std::cerr << "Error: 5/3 DWT plan for " << rows_ << "x" << cols_ << " (" << levels_
+              << " levels) applied to " << p.rows() << "x" << p.cols() << "." << std::endl;
+    return false;
+}
+
+void Dwt53Plan::setLevel(PlaneView<int32_t> image, int l) {
+    block_ = image.sub(0, 0, pyramidExtent(rows_, l), pyramidExtent(cols_, l));
+    tileWidth_ = std::min(kInPlaceTile, columnTileWidth(block_.cols(), pool_));
+}
+
+// An odd last row or column is carried unchanged to the end of the low band
+void Dwt53Plan::rowsForward(int s) {
+    Slot& slot = slots_[s];
+    int h = block_.rows(), w = block_.cols(), slots = static_cast<int>(slots_.size());
+    int lowW = (w + 1) / 2;
+    for (int i = h * s / slots; i < h * (s + 1) / slots; ++i) {
+        int32_t* row = block_.row(i);
+        std::copy(row, row + w, slot.line.begin());
+        lift53RowForward(slot.line.data(), w & ~1, row, row + lowW, slot.even.data(), slot.odd.data());
+        if (w & 1)
+            row[lowW - 1] = slot.line[w - 1];
+    }
+}
+
+void Dwt53Plan::rowsInverse(int s) {
+    Slot& slot = slots_[s];
+    int h = block_.rows(), w = block_.cols(), slots = static_cast<int>(slots_.size());
+    int lowW = (w + 1) / 2;
+    for (int i = h * s / slots; i < h * (s + 1) / slots; ++i) {
+        int32_t* row = block_.row(i);
+        std::copy(row, row + w, slot.line.begin());
+        lift53RowInverse(slot.line.data(), slot.line.data() + lowW, w / 2, row, slot.even.data(), slot.odd.data());
+        if (w & 1)
+            row[w - 1] = slot.line[lowW - 1];
+    }
+}
+
+void Dwt53Plan::columnsForward(int s) {
+    Slot& slot = slots_[s];
+    int h = block_.rows(), w = block_.cols(), slots = static_cast<int>(slots_.size());
+    int lowH = (h + 1) / 2;
+    for (int c0 = s * tileWidth_; c0 < w; c0 += slots * tileWidth_) {
+        int tw = std::min(tileWidth_, w - c0);
+        PlaneView<int32_t> tile = slot.tile.view().sub(0, 0, h, tw);
+        for (int i = 0; i < h; ++i)
+            std::copy(block_.row(i) + c0, block_.row(i) + c0 + tw, tile.row(i));
+        lift53ColumnsForward(tile.sub(0, 0, h & ~1, tw), block_.sub(0, c0, h / 2, tw),
+                             block_.sub(lowH, c0, h / 2, tw));
+        if (h & 1)
+            std::copy(tile.row(h - 1), tile.row(h - 1) + tw, block_.row(lowH - 1) + c0);
+    }
+}
+
+void Dwt53Plan::columnsInverse(int s) {
+    Slot& slot = slots_[s];
+    int h = block_.rows(), w = block_.cols(), slots = static_cast<int>(slots_.size());
+    int lowH = (h + 1) / 2;
+    for (int c0 = s * tileWidth_; c0 < w; c0 += slots * tileWidth_) {
+        int tw = std::min(tileWidth_, w - c0);
+        PlaneView<int32_t> tile = slot.tile.view().sub(0, 0, h, tw);
+        for (int i = 0; i < h; ++i)
+            std::copy(block_.row(i) + c0, block_.row(i) + c0 + tw, tile.row(i));
+        lift53ColumnsInverse(tile.sub(0, 0, h / 2, tw), tile.sub(lowH, 0, h / 2, tw),
+                             block_.sub(0, c0, h & ~1, tw));
+        if (h & 1)
+            std::copy(tile.row(lowH - 1), tile.row(lowH - 1) + tw, block_.row(h - 1) + c0);
+    }
+}
+
+bool Dwt53Plan::forward(PlaneView<int32_t> image) {
+    if (!shapeMatches(image)) return false;
+    int slots = static_cast<int>(slots_.size());
+    for (int l = 0; l < levels_; ++l) {
+        setLevel(image, l);
+        forEachPart(pool_, slots, [this](int s) { rowsForward(s); });
+        forEachPart(pool_, slots, [this](int s) { columnsForward(s); });
+    }
+    return true;
+}
+
+bool Dwt53Plan::inverse(PlaneView<int32_t> coeffs) {
+    if (!shapeMatches(coeffs)) return false;
+    int slots = static_cast<int>(slots_.size());
+    for (int l = levels_ - 1; l >= 0; --l) {
+        setLevel(coeffs, l);
+        forEachPart(pool_, slots, [this](int s) { columnsInverse(s); });
+        forEachPart(pool_, slots, [this](int s) { rowsInverse(s); });
+    }
+    return true;
+}
+
+// N-level in-place reversible 5/3 DWT
+bool dwtPyramid53(PlaneView<int32_t> image, int levels, ThreadPool* pool) {
+    Dwt53Plan plan(image.rows(), image.cols(), levels, pool);
+    return plan.valid() && plan.forward(image);
+}
+
+// N-level in-place inverse 5/3 DWT
+bool idwtPyramid53(PlaneView<int32_t> coeffs, int levels, ThreadPool* pool) {
+    Dwt53Plan plan(coeffs.rows(), coeffs.cols(), levels, pool);
+    return plan.valid() && plan.inverse(coeffs);
+}
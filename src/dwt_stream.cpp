@@ -0,0 +1,91 @@
+#include "dwt_stream.hpp"
+#include "dwt_kernels.hpp"
+#include <iostream>
+
+using namespace dwt_kernels;
+
+StreamingDwt::StreamingDwt(int cols, int levels, CoefficientRowSink sink) : sink_(std::move(sink)) {
+    for (int l = 0; l < levels; ++l) {
+        int w = cols >> l;
+        if (w < 4 || w % 2 != 0) {
+            std::cerr << "Error: " << cols << " columns cannot be streamed through " << levels
+                      << " DWT levels (must be divisible by 2^levels, >= 4 at every level)." << std::endl;
+            levels_.clear();
+            return;
+        }
+        Level level;
+        level.cols = w;
+        level.ring.resize(4 * static_cast<size_t>(w));
+        level.first.resize(2 * static_cast<size_t>(w));
+        level.lo.resize(w);
+        level.hi.resize(w);
+        level.scratch.resize(w / 2 + 1);
+        levels_.push_back(std::move(level));
+    }
+}
+
+void StreamingDwt::pushRow(const float* row) {
+    if (valid())
+        push(0, row);
+}
+
+// Horizontal pass into the ring; once rows 2k..2k+3 are present, row k of the next output is final
+void StreamingDwt::push(int l, const float* row) {
+    Level& L = levels_[l];
+    int w = L.cols;
+    float* slot = L.ring.data() + (L.rowsIn % 4) * w;
+    liftRowForward(row, w, slot, slot + w / 2, L.scratch.data());
+    if (L.rowsIn < 2)
+        std::copy(slot, slot + w, L.first.data() + L.rowsIn * w);
+    ++L.rowsIn;
+
+    if (L.rowsIn >= 4 && L.rowsIn % 2 == 0) {
+        long long k = L.rowsIn / 2 - 2;
+        const float* ring = L.ring.data();
+        emit(l, k, ring + ((2 * k) % 4) * w, ring + ((2 * k + 1) % 4) * w,
+             ring + ((2 * k + 2) % 4) * w, ring + ((2 * k + 3) % 4) * w);
+    }
+}
+
+// Vertical pass for output row k from input rows r0..r3 = 2k..2k+3 (periodic convolution form)
+void StreamingDwt::emit(int l, long long k, const float* r0, const float* r1, const float* r2, const float* r3) {
+    Level& L = levels_[l];
+    int w = L.cols, half = w / 2;
+    combine4Row(L.lo.data(), r0, r1, r2, r3, kDb4Low, w);
+    combine4Row(L.hi.data(), r0, r1, r2, r3, kDb4High, w);
+
+    int level = l + 1, row = static_cast<int>(k);
+    sink_(level, Subband::LH, row, L.lo.data() + half, half);
+    sink_(level, Subband::HL, row, L.hi.data(), half);
+    sink_(level, Subband::HH, row, L.hi.data() + half, half);
+    if (l + 1 < static_cast<int>(levels_.size()))
+        push(l + 1, L.lo.data());
+    else
+        sink_(level, Subband::LL, row, L.lo.data(), half);
+}
+
+bool StreamingDwt::finish() {
+    if (!valid()) return false;
+    for (size_t l = 0; l < levels_.size(); ++l) {
+        Level& L = levels_[l];
+        if (L.rowsIn < 4 || L.rowsIn % 2 != 0) {
+            std::cerr << "Error: level " << l + 1 << " received " << L.rowsIn
+                      << " rows; the streamed height must be divisible by 2^levels." << std::endl;
+            return false;
+        }
+        // Last output row wraps around to the first two input rows
+        int w = L.cols;
+        long long n = L.rowsIn;
+        const float* ring = L.ring.data();
+        emit(static_cast<int>(l), n / 2 - 1, ring + ((n - 2) % 4) * w, ring + ((n - 1) % 4) * w,
+             L.first.data(), L.first.data() + w);
+    }
+    return true;
+}
+
+std::size_t StreamingDwt::bufferedBytes() const {
+    std::size_t bytes = 0;
+    for (const Level& L : levels_)
+        bytes += (L.ring.size() + L.first.size() + L.lo.size() + L.hi.size() + L.scratch.size()) * sizeof(float);
+    return bytes;
+}
@@ -0,0 +1,125 @@
+#include "histogram.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <iostream>
+
+// Sub-histograms counted side by side. Consecutive samples go to different lanes, so runs of
+// one value (common among quantized coefficients) do not chain every increment through the
+// same counter's store and reload.
+static constexpr int kLanes = 4;
+// Samples per pass over the lanes; keeps each 32-bit lane counter below 2^28
+static constexpr size_t kLaneBlock = size_t(1) << 30;
+
+// Smallest and largest of data[0..n), n >= 1, kWidth values at a time
+static void minMax(const int* data, size_t n, int& minV, int& maxV) {
+    constexpr int W = simd::kWidth;
+    simd::VecI lo = simd::set1i(data[0]), hi = lo;
+    size_t j = 0;
+    for (; j + W <= n; j += W) {
+        simd::VecI v = simd::loadi(data + j);
+        lo = simd::mini(lo, v);
+        hi = simd::maxi(hi, v);
+    }
+    int32_t los[W], his[W];
+    simd::storei(los, lo);
+    simd::storei(his, hi);
+    minV = *std::min_element(los, los + W);
+    maxV = *std::max_element(his, his + W);
+    for (; j < n; ++j) {
+        minV = std::min(minV, data[j]);
+        maxV = std::max(maxV, data[j]);
+    }
+}
+
+bool Histogram::count(const int* data, size_t n, long long maxRange) {
+    counts_.clear();
+    minSymbol_ = 0;
+    total_ = 0;
+    distinct_ = 0;
+    if (n == 0) return true;
+
+    int minV = 0, maxV = 0;
+    minMax(data, n, minV, maxV);
+    long long range = static_cast<long long>(maxV) - minV + 1;
+    if (range > maxRange) {
+        std::cerr << "Error: symbol range [" << minV << ", " << maxV << "] is too wide to histogram." << std::endl;
+        return false;
+    }
+    minSymbol_ = minV;
+    total_ = n;
+    const size_t r = static_cast<size_t>(range);
+    counts_.assign(r, 0);
+
+    if (r * kLanes > n) {
+        // Sparse data: clearing and merging the lanes would cost more than the stalls they save
+        for (size_t i = 0; i < n; ++i)
+            ++counts_[static_cast<size_t>(data[i] - minV)];
+    } else {
+        // Symbol k of lane j is lanes_[k * kLanes + j]: the merge reads one line per few symbols
+        lanes_.resize(r * kLanes);
+        for (size_t start = 0; start < n; start += kLaneBlock) {
+            const int* p = data + start;
+            const size_t m = std::min(kLaneBlock, n - start);
+            std::fill(lanes_.begin(), lanes_.end(), 0);
+            uint32_t* lane = lanes_.data();
+            size_t i = 0;
+            for (; i + kLanes <= m; i += kLanes) {
+                ++lane[static_cast<size_t>(p[i] - minV) * kLanes];
+                ++lane[static_cast<size_t>(p[i + 1] - minV) * kLanes + 1];
+                ++lane[static_cast<size_t>(p[i + 2] - minV) * kLanes + 2];
+                ++lane[static_cast<size_t>(p[i + 3] - minV) * kLanes + 3];
+            }
+            for (; i < m; ++i)
+                ++lane[static_cast<size_t>(p[i] - minV) * kLanes];
+            for (size_t k = 0; k < r; ++k)
+                counts_[k] += uint64_t(lane[k * kLanes]) + lane[k * kLanes + 1] + lane[k * kLanes + 2]
+                              + lane[k * kLanes + 3];
+        }
+    }
+
+    for (uint64_t c : counts_)
+        distinct_ += c != 0;
+    return true;
+}
+
+// Extends the counted range to cover [minV, maxV], keeping the counts
+bool Histogram::widen(int minV, int maxV, long long maxRange) {
+    if (!empty()) {
+        minV = std::min(minV, minSymbol_);
+        maxV = std::max(maxV, maxSymbol());
+    }
+    long long range = static_cast<long long>(maxV) - minV + 1;
+    if (range > maxRange) {
+        std::cerr << "Error: symbol range [" << minV << ", " << maxV << "] is too wide to histogram." << std::endl;
+        return false;
+    }
+    // Widen the counted range on either side as new values appear
+    if (empty()) minSymbol_ = minV;
+    counts_.insert(counts_.begin(), static_cast<size_t>(minSymbol_ - minV), 0);
+    counts_.resize(static_cast<size_t>(range), 0);
+    minSymbol_ = minV;
+    return true;
+}
+
+bool Histogram::add(const int* data, size_t n, long long maxRange) {
+    if (n == 0) return true;
+    int minV = 0, maxV = 0;
+    minMax(data, n, minV, maxV);
+    if (!widen(minV, maxV, maxRange)) return false;
+    total_ += n;
+    for (size_t i = 0; i < n; ++i)
+        distinct_ += counts_[static_cast<size_t>(data[i] - minSymbol_)]++ == 0;
+    return true;
+}
+
+bool Histogram::add(const Histogram& other, long long maxRange) {
+    if (other.empty()) return true;
+    if (!widen(other.minSymbol(), other.maxSymbol(), maxRange)) return false;
+    total_ += other.total();
+    uint64_t* counts = counts_.data() + (other.minSymbol() - minSymbol_);
+    for (int k = 0; k < other.range(); ++k) {
+        distinct_ += counts[k] == 0 && other.counts_[k] != 0;
+        counts[k] += other.counts_[k];
+    }
+    return true;
+}
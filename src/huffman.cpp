@@ -1,92 +1,686 @@
 #include "huffman.hpp"
-#include <queue>
-#include <sstream>
-#include <stdexcept>
+#include "bit_io.hpp"
+#include <iostream>
+#include <algorithm>
 
-// Huffman Node
-struct Node {
-    int value;
-    int freq;
-    Node* left;
-    Node* right;
+// Huffman code lengths in place (Moffat and Katajainen, "In-place calculation of
+// minimum-redundancy codes", 1995). On entry a[0..n) holds the weights in ascending order,
+// n >= 2; on exit a[i] is the code length of weight i. Pass 1 builds the tree two-queue style:
+// leaves are consumed from a[leaf...], internal nodes from a[root...], and each slot that has
+// been consumed is reused for a parent index. Pass 2 turns parent indices into internal node
+// depths, pass 3 hands out leaf depths level by level. No memory beyond the array.
+static void huffmanLengthsInPlace(uint64_t* a, int n) {
+    a[0] += a[1];
+    int root = 0, leaf = 2;
+    for (int next = 1; next < n - 1; ++next) {
+        if (leaf >= n || a[root] < a[leaf]) {
+            a[next] = a[root];
+            a[root++] = next;
+        } else {
+            a[next] = a[leaf++];
+        }
+        if (leaf >= n || (root < next && a[root] < a[leaf])) {
+            a[next] += a[root];
+            a[root++] = next;
+        } else {
+            a[next] += a[leaf++];
+        }
+    }
+
+    a[n - 2] = 0;
+    for (int next = n - 3; next >= 0; --next)
+        a[next] = a[a[next]] + 1;
 
-    Node(int v, int f) : value(v), freq(f), left(nullptr), right(nullptr) {}
-    Node(Node* l, Node* r) : value(-1), freq(l->freq + r->freq), left(l), right(r) {}
-    ~Node() { delete left; delete right; }
-};
+    int available = 1, used = 0, depth = 0;
+    root = n - 2;
+    int next = n - 1;
+    while (available > 0) {
+        while (root >= 0 && static_cast<int>(a[root]) == depth) {
+            ++used;
+            --root;
+        }
+        while (available > used) {
+            a[next--] = depth;
+            --available;
+        }
+        available = 2 * used;
+        ++depth;
+        used = 0;
+    }
+}
 
-struct Compare {
-    bool operator()(Node* a, Node* b) {
-        return a->freq > b->freq;
+// Optimal code lengths of at most `limit` bits by package-merge. `symbols` holds (frequency,
+// symbol index) sorted by frequency, and 2^limit >= symbols.size() >= 2. List 1 is the leaves;
+// list k + 1 merges the leaves with the pairs ("packages") of consecutive items of list k.
+// The cheapest 2n - 2 items of list `limit` form the code: each leaf is one bit longer for
+// every list whose selected prefix holds it, and those prefixes always hold the lightest leaves.
+static void packageMergeLengths(const std::vector<std::pair<uint64_t, int>>& symbols, int limit, HuffmanCode& code) {
+    const size_t n = symbols.size();
+    std::vector<uint64_t> previous, packages, merged;
+    std::vector<std::vector<bool>> isLeaf(limit);  // per list, whether each merged item is a leaf
+    for (int k = 0; k < limit; ++k) {
+        packages.clear();
+        for (size_t i = 0; i + 1 < previous.size(); i += 2)
+            packages.push_back(previous[i] + previous[i + 1]);
+        merged.clear();
+        size_t a = 0, b = 0;
+        while (a < n || b < packages.size()) {
+            bool leaf = b == packages.size() || (a < n && symbols[a].first <= packages[b]);
+            merged.push_back(leaf ? symbols[a++].first : packages[b++]);
+            isLeaf[k].push_back(leaf);
+        }
+        previous.swap(merged);
     }
-};
 
-// Generate Huffman codes
-void buildTable(Node* root, const std::string& str, std::unordered_map<int, std::string>& table) {
-    if (!root) return;
-    if (root->value != -1) {
-        table[root->value] = str.empty() ? "0" : str; // Handle single-symbol case
-        return;
+    // Walk the selection back from the last list: its packages select twice as many items below
+    std::vector<int> depth(n, 0);
+    size_t selected = 2 * n - 2;
+    for (int k = limit - 1; k >= 0; --k) {
+        size_t leaves = 0;
+        for (size_t i = 0; i < selected; ++i)
+            leaves += isLeaf[k][i];
+        for (size_t i = 0; i < leaves; ++i)
+            ++depth[i];
+        selected = 2 * (selected - leaves);
     }
-    buildTable(root->left, str + "0", table);
-    buildTable(root->right, str + "1", table);
+    for (size_t i = 0; i < n; ++i)
+        code.lengths[symbols[i].second] = static_cast<uint8_t>(depth[i]);
+}
+
+bool assignCanonicalCodes(HuffmanCode& code) {
+    uint64_t count[kMaxHuffmanLength + 1] = {};
+    for (uint8_t length : code.lengths) {
+        if (length > kMaxHuffmanLength) {
+            std::cerr << "Error: Huffman code length " << int(length) << " exceeds " << kMaxHuffmanLength << " bits." << std::endl;
+            return false;
+        }
+        ++count[length];
+    }
+    // First code of each length: the codes of every shorter length, extended by a zero bit per level
+    uint64_t next[kMaxHuffmanLength + 1] = {};
+    uint64_t first = 0;
+    for (int length = 1; length <= kMaxHuffmanLength; ++length) {
+        first = (first + (length > 1 ? count[length - 1] : 0)) << 1;
+        next[length] = first;
+        if (first + count[length] > (uint64_t(1) << length)) {
+            std::cerr << "Error: Huffman code lengths do not form a prefix code." << std::endl;
+            return false;
+        }
+    }
+    code.codes.assign(code.lengths.size(), 0);
+    for (size_t k = 0; k < code.lengths.size(); ++k)
+        if (code.lengths[k])
+            code.codes[k] = static_cast<uint32_t>(next[code.lengths[k]]++);
+    return true;
+}
+
+bool buildHuffmanCode(const Histogram& hist, HuffmanCode& code, int maxLength) {
+    code = HuffmanCode();
+    if (hist.empty()) return true;
+    if (hist.range() > Histogram::kDefaultMaxRange) {
+        std::cerr << "Error: Huffman symbol range [" << hist.minSymbol() << ", " << hist.maxSymbol()
+                  << "] is too wide." << std::endl;
+        return false;
+    }
+    code.minSymbol = hist.minSymbol();
+    code.lengths.assign(static_cast<size_t>(hist.range()), 0);
+
+    // (frequency, symbol index) by increasing frequency, then lengths in a flat array
+    std::vector<std::pair<uint64_t, int>> symbols;
+    symbols.reserve(hist.distinct());
+    const std::vector<uint64_t>& counts = hist.counts();
+    for (size_t k = 0; k < counts.size(); ++k)
+        if (counts[k])
+            symbols.emplace_back(counts[k], static_cast<int>(k));
+    std::sort(symbols.begin(), symbols.end());
+    const int n = static_cast<int>(symbols.size());
+    if (n == 1) {
+        code.lengths[symbols[0].second] = 1;  // a lone symbol still needs a 1-bit code
+        return assignCanonicalCodes(code);
+    }
+    std::vector<uint64_t> lengths(n);
+    for (int i = 0; i < n; ++i)
+        lengths[i] = symbols[i].first;
+    huffmanLengthsInPlace(lengths.data(), n);
+
+    // Too deep for the limit (raised if needed so that 2^limit codes cover every symbol):
+    // rebuild the lengths with package-merge. The lightest symbol has the longest code.
+    int limit = std::min(maxLength, kMaxHuffmanLength);
+    while ((size_t(1) << limit) < symbols.size())
+        ++limit;
+    if (static_cast<int>(lengths[0]) > limit) {
+        packageMergeLengths(symbols, limit, code);
+    } else {
+        for (int i = 0; i < n; ++i)
+            code.lengths[symbols[i].second] = static_cast<uint8_t>(lengths[i]);
+    }
+    return assignCanonicalCodes(code);
+}
+
+bool buildHuffmanCode(const std::vector<int>& data, HuffmanCode& code, int maxLength) {
+    Histogram hist;
+    if (!hist.count(data)) {
+        code = HuffmanCode();
+        return false;
+    }
+    return buildHuffmanCode(hist, code, maxLength);
 }
 
 // Encoding
-std::string huffmanEncode(const std::vector<int>& data, std::unordered_map<int, std::string>& huffTable) {
-    huffTable.clear();
-    if (data.empty()) return "";
+bool huffmanEncode(const std::vector<int>& data, HuffmanCode& code, HuffmanBits& bits, int maxLength) {
+    Histogram hist;
+    if (!hist.count(data)) {
+        code = HuffmanCode();
+        bits = HuffmanBits();
+        return false;
+    }
+    return huffmanEncode(data, hist, code, bits, maxLength);
+}
 
-    // Count frequencies
-    std::unordered_map<int, int> freq;
-    for (int v : data) freq[v]++;
+bool huffmanEncode(const std::vector<int>& data, const Histogram& hist, HuffmanCode& code, HuffmanBits& bits,
+                   int maxLength) {
+    bits = HuffmanBits();
+    if (!buildHuffmanCode(hist, code, maxLength)) return false;
+    bits.bytes.reserve(data.size() / 2 + 8);
+    BitWriter writer(bits.bytes);
+    for (int v : data) {
+        int k = v - code.minSymbol;
+        writer.put(code.codes[k], code.lengths[k]);
+    }
+    bits.bitCount = writer.finish();
+    return true;
+}
 
-    // Build priority queue
-    std::priority_queue<Node*, std::vector<Node*>, Compare> pq;
-    for (const auto& [val, f] : freq)
-        pq.push(new Node(val, f));
+HuffmanDecoder::HuffmanDecoder(const HuffmanCode& code, int lookupBits) {
+    int maxLength = 1;
+    for (uint8_t length : code.lengths)
+        maxLength = std::max(maxLength, static_cast<int>(length));
+    lookupBits_ = std::min(lookupBits, maxLength);
+    maxLength_ = maxLength;
+    table_.assign(size_t(1) << lookupBits_, Entry());
 
-    // Edge case: only one unique symbol
-    if (pq.size() == 1) {
-        Node* only = pq.top();
-        buildTable(only, "", huffTable);
-        std::string encoded(data.size(), '0');
-        delete only;
-        return encoded;
+    // Sets every entry of the block at `base` (indexed by `bits` bits) whose index starts with
+    // the prefixBits-bit `prefix`
+    auto fill = [this](size_t base, uint32_t prefix, int prefixBits, int bits, Entry entry) {
+        size_t first = base + (static_cast<size_t>(prefix) << (bits - prefixBits));
+        std::fill(table_.begin() + first, table_.begin() + first + (size_t(1) << (bits - prefixBits)), entry);
+    };
+
+    // Short codes own every index they prefix; long codes record, per lookupBits prefix,
+    // how many more bits their block needs
+    for (int k = 0; k < code.symbolCount(); ++k) {
+        int length = code.lengths[k];
+        if (!length) continue;
+        if (length <= lookupBits_) {
+            fill(0, code.codes[k], length, lookupBits_,
+                        Entry{code.minSymbol + k, static_cast<uint8_t>(length), 0});
+        } else {
+            Entry& link = table_[code.codes[k] >> (length - lookupBits_)];
+            link.subBits = std::max<uint8_t>(link.subBits, static_cast<uint8_t>(length - lookupBits_));
+        }
     }
+    for (size_t i = 0; i < (size_t(1) << lookupBits_); ++i) {
+        if (table_[i].length || !table_[i].subBits) continue;
+        table_[i].value = static_cast<int32_t>(table_.size());
+        table_.resize(table_.size() + (size_t(1) << table_[i].subBits));
+    }
+    for (int k = 0; k < code.symbolCount(); ++k) {
+        int length = code.lengths[k];
+        if (length <= lookupBits_) continue;
+        int extra = length - lookupBits_;
+        const Entry& link = table_[code.codes[k] >> extra];
+        fill(link.value, code.codes[k] & ((uint32_t(1) << extra) - 1), extra, link.subBits,
+                    Entry{code.minSymbol + k, static_cast<uint8_t>(length), 0});
+    }
+}
 
-    // Build Huffman tree
-    while (pq.size() > 1) {
-        Node* l = pq.top(); pq.pop();
-        Node* r = pq.top(); pq.pop();
-        pq.push(new Node(l, r));
+std::vector<int> HuffmanDecoder::decode(const HuffmanBits& bits, size_t expectedSymbols) const {
+    std::vector<int> result(expectedSymbols);
+    BitReader reader(bits.bytes.data(), bits.bytes.size());
+    for (size_t n = 0; n < expectedSymbols; ++n) {
+        if (!next(reader, result[n])) {
+            std::cerr << "Error: invalid Huffman code at bit " << reader.position() << "." << std::endl;
+            result.resize(n);
+            return result;
+        }
+        if (reader.position() > bits.bitCount) {
+            std::cerr << "Error: Huffman stream ends after " << n << " symbols." << std::endl;
+            result.resize(n);
+            return result;
+        }
     }
+    return result;
+}
+
+std::vector<int> huffmanDecode(const HuffmanBits& bits, const HuffmanCode& code, size_t expectedSymbols) {
+    return HuffmanDecoder(code).decode(bits, expectedSymbols);
+}
+
+bool countSegments(const std::vector<int>& data, const std::vector<size_t>& sizes, std::vector<Histogram>& hists) {
+    hists.assign(sizes.size(), Histogram());
+    size_t total = 0;
+    for (size_t n : sizes) total += n;
+    if (total != data.size()) {
+        std::cerr << "Error: Huffman segments cover " << total << " of " << data.size() << " symbols." << std::endl;
+        return false;
+    }
+    const int* next = data.data();
+    for (size_t s = 0; s < sizes.size(); next += sizes[s], ++s)
+        if (!hists[s].count(next, sizes[s])) return false;
+    return true;
+}
+
+bool huffmanEncodeSegments(const std::vector<int>& data, const std::vector<size_t>& sizes, int streams,
+                           std::vector<HuffmanCode>& codes, SegmentedBits& bits, int maxLength) {
+    std::vector<Histogram> hists;
+    return countSegments(data, sizes, hists) &&
+           huffmanEncodeSegments(data, sizes, hists, streams, codes, bits, maxLength);
+}
+
+bool huffmanEncodeSegments(const std::vector<int>& data, const std::vector<size_t>& sizes,
+                           const std::vector<Histogram>& hists, int streams, std::vector<HuffmanCode>& codes,
+                           SegmentedBits& bits, int maxLength) {
+    codes.assign(sizes.size(), HuffmanCode());
+    bits = SegmentedBits();
+    if (streams < 1 || streams > kMaxHuffmanStreams) {
+        std::cerr << "Error: " << streams << " Huffman streams (1.." << kMaxHuffmanStreams << " supported)." << std::endl;
+        return false;
+    }
+    bits.streams = streams;
+    size_t total = 0;
+    for (size_t n : sizes) total += n;
+    if (total != data.size() || hists.size() != sizes.size()) {
+        std::cerr << "Error: Huffman segments cover " << total << " of " << data.size() << " symbols." << std::endl;
+        return false;
+    }
+
+    bits.bytes.reserve(data.size() / 2 + 8);
+    bits.streamBits.reserve(sizes.size() * streams);
+    std::vector<uint8_t> pending[kMaxHuffmanStreams];  // streams 1.. of the current segment
+    const int* next = data.data();
+    for (size_t s = 0; s < sizes.size(); next += sizes[s], ++s) {
+        if (hists[s].total() != sizes[s]) {
+            std::cerr << "Error: Huffman segment " << s << " histogram holds " << hists[s].total() << " of "
+                      << sizes[s] << " symbols." << std::endl;
+            return false;
+        }
+        if (!buildHuffmanCode(hists[s], codes[s], maxLength)) return false;
+        const HuffmanCode& code = codes[s];
+        // Symbol i goes to stream i % streams; stream 0 is written in place, the others
+        // are appended after it
+        for (int k = 0; k < streams; ++k) {
+            std::vector<uint8_t>& out = k ? pending[k] : bits.bytes;
+            if (k) out.clear();
+            BitWriter writer(out);
+            for (size_t i = k; i < sizes[s]; i += streams) {
+                int j = next[i] - code.minSymbol;
+                writer.put(code.codes[j], code.lengths[j]);
+            }
+            bits.streamBits.push_back(writer.finish());
+        }
+        for (int k = 1; k < streams; ++k)
+            bits.bytes.insert(bits.bytes.end(), pending[k].begin(), pending[k].end());
+    }
+    return true;
+}
+
+static void writeCodeTable(BitWriter& writer, const HuffmanCode& code);
 
-    Node* root = pq.top();
-    buildTable(root, "", huffTable);
+// Bits that the symbols counted in hist cost under their own code, table included
+static uint64_t segmentCost(const Histogram& hist, int maxLength) {
+    HuffmanCode code;
+    if (!buildHuffmanCode(hist, code, maxLength))
+        return UINT64_MAX / 4;  // never worth a table of its own; the encoder reports the error
+    uint64_t bits = 64;  // the segment's symbol count
+    for (int k = 0; k < code.symbolCount(); ++k)
+        bits += hist.counts()[k] * code.lengths[k];
+    std::vector<uint8_t> table;
+    BitWriter writer(table);
+    writeCodeTable(writer, code);
+    return bits + writer.finish();
+}
 
-    // Encode data
-    std::string encoded;
-    encoded.reserve(data.size() * 2); // Reserve space for speed
-    for (int v : data)
-        encoded += huffTable[v];
+std::vector<size_t> mergeHuffmanSegments(const std::vector<int>& data, const std::vector<size_t>& sizes,
+                                         int maxLength) {
+    std::vector<Histogram> hists;
+    if (!countSegments(data, sizes, hists)) return sizes;  // the encoder reports the mismatch
+    return mergeHuffmanSegments(sizes, hists, maxLength);
+}
 
-    delete root;
-    return encoded;
+std::vector<size_t> mergeHuffmanSegments(const std::vector<size_t>& sizes, std::vector<Histogram>& hists,
+                                         int maxLength) {
+    std::vector<size_t> merged;
+    std::vector<Histogram> groups;
+    uint64_t groupCost = 0;
+    for (size_t s = 0; s < sizes.size(); ++s) {
+        uint64_t alone = segmentCost(hists[s], maxLength);
+        if (!merged.empty()) {
+            Histogram joined = groups.back();
+            if (joined.add(hists[s])) {
+                uint64_t joinedCost = segmentCost(joined, maxLength);
+                if (joinedCost <= groupCost + alone) {
+                    merged.back() += sizes[s];
+                    groups.back() = std::move(joined);
+                    groupCost = joinedCost;
+                    continue;
+                }
+            }
+        }
+        merged.push_back(sizes[s]);
+        groups.push_back(std::move(hists[s]));
+        groupCost = alone;
+    }
+    hists = std::move(groups);
+    return merged;
+}
+
+// Decodes one segment's `Streams` interleaved streams into out[0..n), one symbol from each
+// stream per step: the streams' bit positions are independent chains, so their table lookups
+// overlap instead of waiting on one another. Each round refills every reader once and then
+// decodes as many symbols per stream as 56 bits are sure to hold, without further checks.
+// False if a stream holds an invalid code.
+template <int Streams>
+static bool decodeInterleaved(const HuffmanDecoder& decoder, BitReader* readers, int* out, size_t n) {
+    bool ok = true;
+    const int perRefill = decoder.symbolsPerRefill();
+    const size_t round = static_cast<size_t>(Streams) * perRefill;
+    size_t i = 0;
+    for (; i + round <= n; i += round) {
+        for (int k = 0; k < Streams; ++k)
+            readers[k].refill();
+        for (int j = 0; j < perRefill; ++j)
+            for (int k = 0; k < Streams; ++k)
+                ok &= decoder.next<false>(readers[k], out[i + j * Streams + k]);
+    }
+    for (int k = 0; i < n; ++i, k = (k + 1) % Streams)
+        ok &= decoder.next(readers[k], out[i]);
+    return ok;
 }
 
-// Decoding
-std::vector<int> huffmanDecode(const std::string& encoded, const std::unordered_map<std::string, int>& reverseTable, size_t expectedSymbols) {
-    std::vector<int> result;
-    std::string current;
-    for (char bit : encoded) {
-        current += bit;
-        auto it = reverseTable.find(current);
-        if (it != reverseTable.end()) {
-            result.push_back(it->second);
-            current.clear();
-            if (result.size() == expectedSymbols) break;
+std::vector<int> huffmanDecodeSegments(const SegmentedBits& bits, const std::vector<HuffmanCode>& codes,
+                                       const std::vector<size_t>& sizes, size_t maxSymbols, uint64_t* bitsRead) {
+    size_t total = 0;
+    for (size_t n : sizes) total += n;
+    total = std::min(total, maxSymbols);
+    std::vector<int> result(total);
+    if (bitsRead) *bitsRead = 0;
+    const int streams = bits.streams;
+    if (streams < 1 || streams > kMaxHuffmanStreams || bits.streamBits.size() != codes.size() * streams ||
+        sizes.size() != codes.size()) {
+        std::cerr << "Error: Huffman segment layout does not match its jump table." << std::endl;
+        return {};
+    }
+
+    int* out = result.data();
+    size_t offset = 0;  // first byte of the current stream
+    for (size_t s = 0; s < codes.size() && out != result.data() + total; ++s) {
+        const size_t count = std::min(sizes[s], static_cast<size_t>(result.data() + total - out));
+        // Each reader starts at its stream's byte offset and may run on into the next
+        // stream; only the positions checked below matter
+        BitReader readers[kMaxHuffmanStreams];
+        const uint64_t* streamBits = &bits.streamBits[s * streams];
+        for (int k = 0; k < streams; ++k) {
+            if (offset > bits.bytes.size()) offset = bits.bytes.size();
+            readers[k] = BitReader(bits.bytes.data() + offset, bits.bytes.size() - offset);
+            offset += static_cast<size_t>((streamBits[k] + 7) / 8);
+        }
+        bool ok = true;
+        if (count) {
+            HuffmanDecoder decoder(codes[s]);
+            switch (streams) {
+                case 1: ok = decodeInterleaved<1>(decoder, readers, out, count); break;
+                case 2: ok = decodeInterleaved<2>(decoder, readers, out, count); break;
+                case 3: ok = decodeInterleaved<3>(decoder, readers, out, count); break;
+                default: ok = decodeInterleaved<4>(decoder, readers, out, count); break;
+            }
+        }
+        for (int k = 0; k < streams; ++k) {
+            ok = ok && readers[k].position() <= streamBits[k];
+            if (bitsRead) *bitsRead += readers[k].position();
         }
+        if (!ok || offset > bits.bytes.size()) {
+            std::cerr << "Error: Huffman segment " << s << " is truncated or holds an invalid code." << std::endl;
+            result.resize(out - result.data());
+            return result;
+        }
+        out += count;
     }
     return result;
-}
\ No newline at end of file
+}
+
+// Elias gamma code of x >= 1: floor(log2 x) zero bits, then x in binary
+static void putGamma(BitWriter& writer, uint32_t x) {
+    int bits = 0;
+    while ((x >> bits) > 1) ++bits;
+    writer.put(0, bits);
+    writer.put(x, bits + 1);
+}
+
+static void put64(BitWriter& writer, uint64_t x) {
+    writer.put(static_cast<uint32_t>(x >> 32), 32);
+    writer.put(static_cast<uint32_t>(x), 32);
+}
+
+static uint32_t read(BitReader& reader, int n) {
+    uint32_t v = reader.peek(n);
+    reader.skip(n);
+    return v;
+}
+
+static uint64_t read64(BitReader& reader) {
+    uint64_t high = read(reader, 32);
+    return (high << 32) | read(reader, 32);
+}
+
+// Code table layout, most significant bit first:
+//   32  minSymbol (two's complement)    32  symbol range    32  coded symbols P
+//   if P > 0, the code of their lengths: 5 (smallest length - 1), 5 (length range - 1),
+//       5 per length of the range (its code length, 0 if unused)
+//   per coded symbol, in symbol order: gamma(1 + unused symbols since the previous one),
+//       then its length under the length code
+static void writeCodeTable(BitWriter& writer, const HuffmanCode& code) {
+    std::vector<int> lengths;
+    for (uint8_t length : code.lengths)
+        if (length) lengths.push_back(length);
+    HuffmanCode lengthCode;
+    buildHuffmanCode(lengths, lengthCode);  // at most kMaxHuffmanLength symbols, cannot fail
+
+    writer.put(static_cast<uint32_t>(code.minSymbol), 32);
+    writer.put(static_cast<uint32_t>(code.symbolCount()), 32);
+    writer.put(static_cast<uint32_t>(lengths.size()), 32);
+    if (!lengths.empty()) {
+        writer.put(lengthCode.minSymbol - 1, 5);
+        writer.put(lengthCode.symbolCount() - 1, 5);
+        for (uint8_t length : lengthCode.lengths)
+            writer.put(length, 5);
+    }
+    int previous = -1;
+    for (int k = 0; k < code.symbolCount(); ++k) {
+        int length = code.lengths[k];
+        if (!length) continue;
+        putGamma(writer, static_cast<uint32_t>(k - previous));
+        int j = length - lengthCode.minSymbol;
+        writer.put(lengthCode.codes[j], lengthCode.lengths[j]);
+        previous = k;
+    }
+}
+
+// Reads a writeCodeTable table from a buffer of `size` bytes and rebuilds its codes; false
+// (after printing why) if it is truncated or inconsistent
+static bool readCodeTable(BitReader& reader, size_t size, HuffmanCode& code) {
+    auto truncated = [&reader, size]() { return reader.position() > static_cast<uint64_t>(size) * 8; };
+    code = HuffmanCode();
+    code.minSymbol = static_cast<int32_t>(read(reader, 32));
+    uint32_t range = read(reader, 32);
+    uint32_t coded = read(reader, 32);
+    if (truncated() || range > Histogram::kDefaultMaxRange || coded > range ||
+        static_cast<int64_t>(code.minSymbol) + range - 1 > INT32_MAX) {
+        std::cerr << "Error: Huffman table header is truncated or inconsistent." << std::endl;
+        return false;
+    }
+    code.lengths.assign(range, 0);
+    if (coded > 0) {
+        HuffmanCode lengthCode;
+        lengthCode.minSymbol = static_cast<int>(read(reader, 5)) + 1;
+        lengthCode.lengths.resize(read(reader, 5) + 1);
+        for (uint8_t& length : lengthCode.lengths)
+            length = static_cast<uint8_t>(read(reader, 5));
+        if (!assignCanonicalCodes(lengthCode)) return false;
+        HuffmanDecoder lengthDecoder(lengthCode);
+
+        int64_t k = -1;
+        bool ok = true;
+        for (uint32_t i = 0; i < coded && ok; ++i) {
+            int zeros = 0;
+            while (zeros <= 24 && !read(reader, 1))
+                ++zeros;
+            if (zeros > 24) {  // a gap wider than any symbol range
+                ok = false;
+                break;
+            }
+            k += static_cast<int64_t>((uint32_t(1) << zeros) | (zeros ? read(reader, zeros) : 0));
+            int length = 0;
+            ok = k < range && lengthDecoder.next(reader, length) && !truncated();
+            if (ok) code.lengths[k] = static_cast<uint8_t>(length);
+        }
+        if (!ok) {
+            std::cerr << "Error: Huffman code lengths are truncated or out of range." << std::endl;
+            return false;
+        }
+    }
+    return assignCanonicalCodes(code);
+}
+
+// Copies the bitCount bits that follow the header (ending at bit `headerBits`) into bits
+static bool readPayload(const uint8_t* data, size_t size, uint64_t headerBits, HuffmanBits& bits,
+                        size_t* headerBytes) {
+    size_t header = static_cast<size_t>((headerBits + 7) / 8);
+    if (header > size || (size - header) * 8 < bits.bitCount) {
+        std::cerr << "Error: Huffman stream is truncated (" << size << " bytes)." << std::endl;
+        return false;
+    }
+    bits.bytes.assign(data + header, data + header + (bits.bitCount + 7) / 8);
+    if (headerBytes) *headerBytes = header;
+    return true;
+}
+
+// Layout: 64 symbols, 64 bit count, the code table, zero padding to a whole byte, the bits
+std::vector<uint8_t> serializeHuffman(const HuffmanCode& code, const HuffmanBits& bits, uint64_t symbols) {
+    std::vector<uint8_t> out;
+    BitWriter writer(out);
+    put64(writer, symbols);
+    put64(writer, bits.bitCount);
+    writeCodeTable(writer, code);
+    writer.finish();
+    out.insert(out.end(), bits.bytes.begin(), bits.bytes.begin() + (bits.bitCount + 7) / 8);
+    return out;
+}
+
+bool deserializeHuffman(const uint8_t* data, size_t size, HuffmanCode& code, HuffmanBits& bits,
+                        uint64_t& symbols, size_t* headerBytes) {
+    code = HuffmanCode();
+    bits = HuffmanBits();
+    BitReader reader(data, size);
+    symbols = read64(reader);
+    bits.bitCount = read64(reader);
+    // Every code is at least one bit long
+    if (symbols > bits.bitCount) {
+        std::cerr << "Error: Huffman header is truncated or inconsistent." << std::endl;
+        return false;
+    }
+    return readCodeTable(reader, size, code) && readPayload(data, size, reader.position(), bits, headerBytes);
+}
+
+// Bits needed to write x
+static int bitWidth(uint64_t x) {
+    int width = 0;
+    while (width < 64 && (x >> width)) ++width;
+    return width;
+}
+
+// Layout: 32 segment count S, 8 streams per segment T; then per segment 64 symbols, its code
+// table, and its jump table: 7 (width w), then T stream lengths in bits, w bits each (split
+// into 32-bit fields when w > 32); zero padding to a whole byte; then the streams, segment by
+// segment, each padded to a whole byte
+std::vector<uint8_t> serializeHuffmanSegments(const std::vector<HuffmanCode>& codes,
+                                              const std::vector<size_t>& sizes, const SegmentedBits& bits) {
+    std::vector<uint8_t> out;
+    BitWriter writer(out);
+    writer.put(static_cast<uint32_t>(codes.size()), 32);
+    writer.put(static_cast<uint32_t>(bits.streams), 8);
+    for (size_t s = 0; s < codes.size(); ++s) {
+        put64(writer, sizes[s]);
+        writeCodeTable(writer, codes[s]);
+        const uint64_t* streamBits = &bits.streamBits[s * bits.streams];
+        int width = 0;
+        for (int k = 0; k < bits.streams; ++k)
+            width = std::max(width, bitWidth(streamBits[k]));
+        writer.put(static_cast<uint32_t>(width), 7);
+        for (int k = 0; k < bits.streams; ++k) {
+            if (width > 32) writer.put(static_cast<uint32_t>(streamBits[k] >> 32), width - 32);
+            writer.put(static_cast<uint32_t>(streamBits[k]), std::min(width, 32));
+        }
+    }
+    writer.finish();
+    out.insert(out.end(), bits.bytes.begin(), bits.bytes.end());
+    return out;
+}
+
+bool deserializeHuffmanSegments(const uint8_t* data, size_t size, std::vector<HuffmanCode>& codes,
+                                std::vector<size_t>& sizes, SegmentedBits& bits, size_t* headerBytes,
+                                uint64_t leadingSymbols) {
+    codes.clear();
+    sizes.clear();
+    bits = SegmentedBits();
+    BitReader reader(data, size);
+    uint32_t segments = read(reader, 32);
+    bits.streams = static_cast<int>(read(reader, 8));
+    // Each segment takes at least 167 header bits (symbols, range, minSymbol, coded count, width)
+    if (bits.streams < 1 || bits.streams > kMaxHuffmanStreams ||
+        static_cast<uint64_t>(segments) * 167 > static_cast<uint64_t>(size) * 8) {
+        std::cerr << "Error: Huffman header is truncated or inconsistent." << std::endl;
+        return false;
+    }
+    codes.resize(segments);
+    sizes.resize(segments);
+    bits.streamBits.resize(static_cast<size_t>(segments) * bits.streams);
+    uint64_t payload = 0;  // bytes of the kept streams so far
+    uint64_t before = 0;   // symbols of the segments so far
+    size_t kept = 0;
+    bool keep = true;
+    for (uint32_t s = 0; s < segments; ++s) {
+        keep = keep && before < leadingSymbols;
+        uint64_t symbols = read64(reader);
+        if (!readCodeTable(reader, size, codes[s])) return false;
+        int width = static_cast<int>(read(reader, 7));
+        bool ok = width <= 64;
+        for (int k = 0; k < bits.streams && ok; ++k) {
+            uint64_t length = 0;
+            if (width > 32) length = static_cast<uint64_t>(read(reader, width - 32)) << 32;
+            if (width > 0) length |= read(reader, std::min(width, 32));
+            // Every code is at least one bit long, and only kept streams must lie within data
+            uint64_t streamSymbols = symbols > static_cast<uint64_t>(k) ? (symbols - k + bits.streams - 1) / bits.streams : 0;
+            ok = streamSymbols <= length && (!keep || length <= static_cast<uint64_t>(size) * 8);
+            bits.streamBits[s * bits.streams + k] = length;
+            if (keep) payload += (length + 7) / 8;
+        }
+        if (!ok || reader.position() > static_cast<uint64_t>(size) * 8 || payload > size) {
+            std::cerr << "Error: Huffman header is truncated or inconsistent." << std::endl;
+            return false;
+        }
+        sizes[s] = static_cast<size_t>(symbols);
+        before += symbols;
+        if (keep) kept = s + 1;
+    }
+    codes.resize(kept);
+    sizes.resize(kept);
+    bits.streamBits.resize(kept * bits.streams);
+    size_t header = static_cast<size_t>((reader.position() + 7) / 8);
+    if (header > size || size - header < payload) {
+        std::cerr << "Error: Huffman stream is truncated (" << size << " bytes)." << std::endl;
+        return false;
+    }
+    bits.bytes.assign(data + header, data + header + payload);
+    if (headerBytes) *headerBytes = header;
+    return true;
+}
@@ -3,10 +3,12 @@
 #include <iostream>
 #include <opencv2/opencv.hpp>
 #include <algorithm>
+#include <cctype>
 #include <cmath>
+#include <cstdlib>
 
 // Loads a binary float image (square or rectangular)
-std::vector<std::vector<float>> loadBinImage(const std::string& path, int& rows, int& cols) {
+Plane<float> loadBinImage(const std::string& path, int& rows, int& cols) {
     std::ifstream file(path, std::ios::binary | std::ios::ate);
     if (!file) {
         std::cerr << "❌ Cannot open binary file: " << path << std::endl;
@@ -33,56 +35,126 @@ std::vector<std::vector<float>> loadBinImage(const std::string& path, int& rows,
         return {};
     }
 
-    std::vector<float> buffer(total_floats);
-    file.read(reinterpret_cast<char*>(buffer.data()), total_floats * sizeof(float));
-    if (!file) {
-        std::cerr << "❌ Failed to read all data from " << path << std::endl;
-        return {};
+    // Read each row straight into its aligned slot in the plane
+    Plane<float> image(rows, cols);
+    for (int i = 0; i < rows; ++i) {
+        file.read(reinterpret_cast<char*>(image.row(i)), static_cast<std::streamsize>(cols) * sizeof(float));
+        if (!file) {
+            std::cerr << "❌ Failed to read all data from " << path << std::endl;
+            return {};
+        }
     }
 
-    std::vector<std::vector<float>> image(rows, std::vector<float>(cols));
-    for (int i = 0; i < rows; ++i)
-        std::copy(buffer.begin() + i * cols, buffer.begin() + (i + 1) * cols, image[i].begin());
-
     return image;
 }
 
+// "key = value" lines of an ENVI header; braces ({...}) may span lines and are skipped
+bool readEnviHeader(const std::string& binPath, int& rows, int& cols, int& bands) {
+    std::string base = binPath;
+    size_t dot = base.find_last_of('.'), slash = base.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || slash < dot)) base.erase(dot);
+    std::ifstream file(base + ".hdr");
+    if (!file) file.open(binPath + ".hdr");
+    if (!file) return false;
+
+    int samples = 0, lines = 0, bandCount = 1, dataType = 4;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = line.substr(0, eq);
+        key.erase(0, key.find_first_not_of(" \t"));
+        key.erase(key.find_last_not_of(" \t\r") + 1);
+        std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+        std::string value = line.substr(eq + 1);
+        if (value.find('{') != std::string::npos) {
+            while (value.find('}') == std::string::npos && std::getline(file, line)) value += line;
+            continue;
+        }
+        int number = std::atoi(value.c_str());
+        if (key == "samples") samples = number;
+        else if (key == "lines") lines = number;
+        else if (key == "bands") bandCount = number;
+        else if (key == "data type") dataType = number;
+    }
+    if (samples <= 0 || lines <= 0) return false;
+    if (dataType != 4) {
+        std::cerr << "⚠️ ENVI header for " << binPath << " declares data type " << dataType
+                  << "; reading the samples as float32 anyway." << std::endl;
+    }
+    rows = lines;
+    cols = samples;
+    bands = bandCount;
+    return true;
+}
+
+bool BinRowReader::open(const std::string& path, int cols) {
+    file_.close();
+    file_.clear();
+    rows_ = cols_ = 0;
+    file_.open(path, std::ios::binary | std::ios::ate);
+    if (!file_ || cols <= 0) {
+        std::cerr << "❌ Cannot open binary file: " << path << std::endl;
+        return false;
+    }
+    std::streamsize size = file_.tellg();
+    file_.seekg(0, std::ios::beg);
+    std::streamsize rowBytes = static_cast<std::streamsize>(cols) * sizeof(float);
+    if (size % rowBytes != 0) {
+        std::cerr << "❌ File size is not a whole number of " << cols << "-column rows for " << path << std::endl;
+        return false;
+    }
+    rows_ = static_cast<int>(size / rowBytes);
+    cols_ = cols;
+    return true;
+}
+
+bool BinRowReader::readRow(float* dst) {
+    file_.read(reinterpret_cast<char*>(dst), static_cast<std::streamsize>(cols_) * sizeof(float));
+    return static_cast<bool>(file_);
+}
+
 // Saves a single-channel float image as PNG/JPG (auto-clamps to [0,255])
-void saveImage(const std::vector<std::vector<float>>& image, const std::string& path) {
-    if (image.empty() || image[0].empty()) {
+void saveImage(PlaneView<const float> image, const std::string& path) {
+    if (image.empty()) {
         std::cerr << "❌ Empty image, cannot save to " << path << std::endl;
         return;
     }
-    int h = image.size();
-    int w = image[0].size();
+    int h = image.rows();
+    int w = image.cols();
     cv::Mat img(h, w, CV_8UC1);
-    for (int i = 0; i < h; ++i)
+    for (int i = 0; i < h; ++i) {
+        const float* src = image.row(i);
         for (int j = 0; j < w; ++j)
-            img.at<uchar>(i, j) = static_cast<uchar>(std::clamp(static_cast<int>(std::round(image[i][j])), 0, 255));
+            img.at<uchar>(i, j) = static_cast<uchar>(std::clamp(static_cast<int>(std::round(src[j])), 0, 255));
+    }
     if (!cv::imwrite(path, img)) {
         std::cerr << "❌ Failed to write image to " << path << std::endl;
     }
 }
 
 // Saves a 3-channel float image as PNG/JPG (auto-clamps to [0,255])
-void saveColorImage(const std::vector<std::vector<float>>& R,
-                    const std::vector<std::vector<float>>& G,
-                    const std::vector<std::vector<float>>& B,
+void saveColorImage(PlaneView<const float> R,
+                    PlaneView<const float> G,
+                    PlaneView<const float> B,
                     const std::string& path) {
     if (R.empty() || G.empty() || B.empty() ||
-        R.size() != G.size() || R.size() != B.size() ||
-        R[0].size() != G[0].size() || R[0].size() != B[0].size()) {
+        R.rows() != G.rows() || R.rows() != B.rows() ||
+        R.cols() != G.cols() || R.cols() != B.cols()) {
         std::cerr << "❌ Channel size mismatch or empty, cannot save color image to " << path << std::endl;
         return;
     }
-    int h = R.size();
-    int w = R[0].size();
+    int h = R.rows();
+    int w = R.cols();
     cv::Mat colorImg(h, w, CV_8UC3);
     for (int i = 0; i < h; ++i) {
+        const float* rRow = R.row(i);
+        const float* gRow = G.row(i);
+        const float* bRow = B.row(i);
         for (int j = 0; j < w; ++j) {
-            int r = static_cast<int>(std::round(R[i][j]));
-            int g = static_cast<int>(std::round(G[i][j]));
-            int b = static_cast<int>(std::round(B[i][j]));
+            int r = static_cast<int>(std::round(rRow[j]));
+            int g = static_cast<int>(std::round(gRow[j]));
+            int b = static_cast<int>(std::round(bRow[j]));
             colorImg.at<cv::Vec3b>(i, j) = cv::Vec3b(
                 std::clamp(b, 0, 255),
                 std::clamp(g, 0, 255),
@@ -93,4 +165,26 @@ void saveColorImage(const std::vector<std::vector<float>>& R,
     if (!cv::imwrite(path, colorImg)) {
         std::cerr << "❌ Failed to save color image to " << path << std::endl;
     }
-}
\ No newline at end of file
+}
+
+// Saves a 3-channel image that is already 8-bit
+void saveColorImage(PlaneView<const uint8_t> R,
+                    PlaneView<const uint8_t> G,
+                    PlaneView<const uint8_t> B,
+                    const std::string& path) {
+    if (R.empty() || G.empty() || B.empty() ||
+        R.rows() != G.rows() || R.rows() != B.rows() ||
+        R.cols() != G.cols() || R.cols() != B.cols()) {
+        std::cerr << "❌ Channel size mismatch or empty, cannot save color image to " << path << std::endl;
+        return;
+    }
+    cv::Mat colorImg(R.rows(), R.cols(), CV_8UC3);
+    for (int i = 0; i < R.rows(); ++i) {
+        cv::Vec3b* dst = colorImg.ptr<cv::Vec3b>(i);
+        for (int j = 0; j < R.cols(); ++j)
+            dst[j] = cv::Vec3b(B(i, j), G(i, j), R(i, j));
+    }
+    if (!cv::imwrite(path, colorImg)) {
+        std::cerr << "❌ Failed to save color image to " << path << std::endl;
+    }
+}
@@ -1,97 +1,860 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
-#include <unordered_map>
 #include <vector>
 #include <string>
 #include "dwt_db4.hpp"
+#include "dwt_plan.hpp"
+#include "dwt_stream.hpp"
+#include "histogram.hpp"
 #include "huffman.hpp"
 #include "image_io.hpp"
 #include "utils.hpp"
+#include "thread_pool.hpp"
 #include <iomanip> // Add this at the top for std::setw and std::setprecision
 #include <algorithm>
-
-// Function to detect image size from a binary file (returns 0 on success, -1 on failure)
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+
+// Function to detect image size from a binary file (returns 0 on success, -1 on failure).
+// The ENVI header next to the band gives the real (possibly rectangular) size; without one
+// the band is assumed to be square.
 int detectSize(const std::string& filename, int& rows, int& cols) {
     std::ifstream file(filename, std::ios::binary | std::ios::ate);
     if (!file) return -1;
     std::streamsize size = file.tellg();
     file.close();
     if (size % sizeof(float) != 0) return -1;
-    int pixelCount = size / sizeof(float);
-    int dim = static_cast<int>(std::sqrt(pixelCount));
-    if (dim * dim != pixelCount) return -1;
+    long long pixelCount = size / sizeof(float);
+
+    int bands = 1;
+    if (readEnviHeader(filename, rows, cols, bands)) {
+        if (static_cast<long long>(rows) * cols != pixelCount) {
+            std::cerr << "❌ " << filename << " holds " << pixelCount << " samples, its header says "
+                      << rows << "x" << cols << "." << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+    int dim = static_cast<int>(std::sqrt(static_cast<double>(pixelCount)));
+    if (static_cast<long long>(dim) * dim != pixelCount) return -1;
     rows = cols = dim;
     return 0;
 }
 
-// Pads a 2D vector to even dimensions by duplicating the last row/column if needed
-void padToEven(std::vector<std::vector<float>>& img) {
-    if (img.empty()) return;
-    // Pad rows
-    if (img.size() % 2 != 0) {
-        img.push_back(img.back());
-    }
-    // Pad columns
-    size_t cols = img[0].size();
-    if (cols % 2 != 0) {
-        for (auto& row : img) {
-            row.push_back(row.back());
+// Short name of a pyramid subband, e.g. "HL2"
+std::string subbandName(int level, Subband band) {
+    static const char* names[] = { "LL", "LH", "HL", "HH" };
+    return names[static_cast<int>(band)] + std::to_string(level);
+}
+
+// --- Adaptive Quantization: set different qsteps for each subband ---
+// LL of the coarsest level, then {LH, HL, HH} per level (index 0 = level 1);
+// levels beyond the table reuse its last row
+float qstepFor(int level, Subband band) {
+    static const float q_LL = 0.2f;
+    static const float q_detail[][3] = {
+        { 5.0f, 5.0f, 20.0f },   // level 1
+        { 2.0f, 2.0f, 10.0f },   // level 2
+    };
+    if (band == Subband::LL) return q_LL;
+    const int tableLevels = static_cast<int>(sizeof(q_detail) / sizeof(q_detail[0]));
+    return q_detail[std::min(level, tableLevels) - 1][static_cast<int>(band) - 1];
+}
+
+// Quantize a subband in-place
+void quantize(PlaneView<float> band, float qstep) {
+    for (int i = 0; i < band.rows(); ++i) {
+        float* row = band.row(i);
+        for (int j = 0; j < band.cols(); ++j)
+            row[j] = std::round(row[j] / qstep);
+    }
+}
+
+// Dequantize a subband in-place
+void dequantize(PlaneView<float> band, float qstep) {
+    for (int i = 0; i < band.rows(); ++i) {
+        float* row = band.row(i);
+        for (int j = 0; j < band.cols(); ++j)
+            row[j] = row[j] * qstep;
+    }
+}
+
+// Min/max over every element of a plane
+void planeMinMax(PlaneView<const float> img, float& minV, float& maxV) {
+    minV = maxV = img(0, 0);
+    for (int i = 0; i < img.rows(); ++i) {
+        const float* row = img.row(i);
+        for (int j = 0; j < img.cols(); ++j) {
+            if (row[j] < minV) minV = row[j];
+            if (row[j] > maxV) maxV = row[j];
         }
     }
 }
 
-// Checks that all rows in a 2D vector have the same size; prints error if not
-bool checkRowSizes(const std::vector<std::vector<float>>& img, const std::string& name) {
-    if (img.empty()) return true;
-    size_t cols = img[0].size();
-    for (size_t i = 0; i < img.size(); ++i) {
-        if (img[i].size() != cols) {
-            std::cerr << "❌ Error: " << name << " row " << i << " has size " << img[i].size()
-                      << " (expected " << cols << ")" << std::endl;
-            return false;
+// Normalize a plane to [0,255] in-place
+void normalize(PlaneView<float> img) {
+    float minVal, maxVal;
+    planeMinMax(img, minVal, maxVal);
+    if (maxVal > minVal) {
+        for (int i = 0; i < img.rows(); ++i) {
+            float* row = img.row(i);
+            for (int j = 0; j < img.cols(); ++j)
+                row[j] = 255.0f * (row[j] - minVal) / (maxVal - minVal);
+        }
+    }
+}
+
+// Print min/max and a small block (e.g., top-left 2x2) of a 2D matrix
+template <typename T>
+void printBlockStats(std::ostream& os, PlaneView<const T> mat, const std::string& name) {
+    T minV = mat(0, 0), maxV = mat(0, 0);
+    for (int i = 0; i < mat.rows(); ++i) {
+        for (int j = 0; j < mat.cols(); ++j) {
+            minV = std::min(minV, mat(i, j));
+            maxV = std::max(maxV, mat(i, j));
         }
     }
+    os << "----------------------------------------" << std::endl;
+    os << "[" << name << "]" << std::endl;
+    os << "  min: " << minV << ", max: " << maxV << std::endl;
+    os << "  Top-left 2x2 block:" << std::endl;
+    for (int i = 0; i < std::min(2, mat.rows()); ++i) {
+        os << "    ";
+        for (int j = 0; j < std::min(2, mat.cols()); ++j) {
+            os << std::setw(8) << std::fixed << std::setprecision(2) << mat(i, j) << " ";
+        }
+        os << std::endl;
+    }
+    os << "----------------------------------------" << std::endl;
+}
+
+void printMatrixStats(std::ostream& os, PlaneView<const float> mat, const std::string& name) {
+    printBlockStats(os, mat, name);
+}
+void printMatrixStats(std::ostream& os, PlaneView<const int> mat, const std::string& name) {
+    printBlockStats(os, mat, name);
+}
+
+// Nanoseconds elapsed since `start`, per pixel of a rows x cols image
+double nsPerPixel(std::chrono::steady_clock::time_point start, int rows, int cols) {
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (static_cast<double>(rows) * cols);
+}
+
+// '0'/'1' text of the low `length` bits of a code
+std::string bitString(uint32_t bits, int length) {
+    std::string text(length, '0');
+    for (int i = 0; i < length; ++i)
+        if ((bits >> (length - 1 - i)) & 1) text[i] = '1';
+    return text;
+}
+
+// '0'/'1' text of the first (at most) `count` of the `available` bits packed in bytes
+std::string bitString(const std::vector<uint8_t>& bytes, uint64_t available, uint64_t count) {
+    std::string text;
+    for (uint64_t i = 0; i < std::min(count, available); ++i)
+        text += (bytes[i / 8] >> (7 - i % 8)) & 1 ? '1' : '0';
+    return text;
+}
+
+// Writes a serialized stream (header + bits) to path
+bool saveEncoded(const std::string& path, const std::vector<uint8_t>& file) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error: Could not open " << path << " for writing." << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    return static_cast<bool>(out);
+}
+
+// Decodes a per-subband (segmented) stream from its bytes alone, as a separate reader would;
+// empty on failure
+std::vector<int> decodeSegments(const std::vector<uint8_t>& file) {
+    std::vector<HuffmanCode> codes;
+    std::vector<size_t> sizes;
+    SegmentedBits bits;
+    if (!deserializeHuffmanSegments(file.data(), file.size(), codes, sizes, bits)) return {};
+    return huffmanDecodeSegments(bits, codes, sizes);
+}
+
+// Stored form of quantized subbands (symbols holds subbands[s] symbols of each in turn, e.g.
+// pyramidCodingSizes): one Huffman table per subband, or per run of neighbouring subbands where
+// that is smaller, each split into interleaved streams. Every subband is counted once. Without
+// merge every subband keeps its own table, so each level boundary is also a segment boundary.
+// Empty on failure.
+std::vector<uint8_t> encodeSubbands(const std::vector<int>& symbols, const std::vector<size_t>& subbands,
+                                    bool merge = true) {
+    std::vector<Histogram> hists;
+    if (!countSegments(symbols, subbands, hists)) return {};
+    const std::vector<size_t> sizes = merge ? mergeHuffmanSegments(subbands, hists) : subbands;
+    std::vector<HuffmanCode> codes;
+    SegmentedBits encoded;
+    if (!huffmanEncodeSegments(symbols, sizes, hists, kMaxHuffmanStreams, codes, encoded)) return {};
+    return serializeHuffmanSegments(codes, sizes, encoded);
+}
+
+// Runs task(band, log) for every band as a pool task. Each task writes its report, failures
+// included, to its own log (starting from std::cout's formatting), and the logs are printed in
+// band order once all have finished, so the output does not depend on scheduling. Returns the
+// first band's nonzero status, or 0.
+int runBandTasks(ThreadPool& pool, int bands, const std::function<int(int, std::ostream&)>& task) {
+    std::vector<std::ostringstream> logs(bands);
+    std::vector<int> status(bands, 0);
+    pool.parallelFor(bands, [&](int b) {
+        logs[b].copyfmt(std::cout);
+        status[b] = task(b, logs[b]);
+    });
+    for (int b = 0; b < bands; ++b) {
+        std::cout << logs[b].str();
+        if (status[b] != 0) return status[b];
+    }
+    return 0;
+}
+
+// Size n padded up to a multiple of 2^levels, as the streamed DWT needs
+static int paddedToLevels(int n, int levels) {
+    const int multiple = 1 << levels;
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+// Runs the band at inPath through the line-based DWT and hands every quantized coefficient
+// row to row(level, band, symbols, n), stopping if it returns false. The image is padded to
+// paddedToLevels sizes (last column and last row repeated). rows receives the input's height
+// and windowBytes the DWT's row buffers.
+static bool streamQuantizedRows(const std::string& inPath, int cols, int levels, int& rows, size_t& windowBytes,
+                                const std::function<bool(int, Subband, const int*, int)>& row) {
+    BinRowReader reader;
+    if (!reader.open(inPath, cols)) return false;
+    const int paddedCols = paddedToLevels(cols, levels);
+    const int paddedRows = paddedToLevels(reader.rows(), levels);
+    rows = reader.rows();
+    std::vector<float> line(paddedCols);
+    std::vector<int> symbols(paddedCols);
+    bool ok = true;
+
+    StreamingDwt dwt(paddedCols, levels, [&](int level, Subband band, int, const float* data, int n) {
+        float q = qstepFor(level, band);
+        for (int j = 0; j < n; ++j)
+            symbols[j] = static_cast<int>(std::round(data[j] / q));
+        ok = ok && row(level, band, symbols.data(), n);
+    });
+    if (!dwt.valid()) return false;
+    windowBytes = dwt.bufferedBytes();
+
+    for (int i = 0; i < paddedRows && ok; ++i) {
+        if (i < reader.rows()) {
+            if (!reader.readRow(line.data())) {
+                std::cerr << "❌ Failed to read row " << i << " from " << inPath << std::endl;
+                return false;
+            }
+            std::fill(line.begin() + cols, line.end(), line[cols - 1]);
+        }
+        dwt.pushRow(line.data());
+    }
+    bool finished = ok && dwt.finish();
+    return finished && ok;
+}
+
+// Whole coefficient rows a subband gathers before they are coded as one chunk
+constexpr size_t kStreamChunkSymbols = size_t(1) << 16;
+
+// Streams one band through a line-based DWT in a single pass and writes the quantized rows out
+// as they come, never holding the band or its coded bits: each subband gathers rows until it has
+// kStreamChunkSymbols, then codes them as one chunk with its own table (a one-segment
+// serializeHuffmanSegments buffer) appended to outPath. After the chunks, outPath has
+//   jump table  per chunk: 8-bit subband (its index in pyramidCodingOrder), 64-bit byte offset
+//   footer      32-bit rows, cols (the input's), padded rows, padded cols, 8-bit levels,
+//               32-bit chunk count, 64-bit jump table offset: the file's last 29 bytes
+// all MSB-first. A subband's chunks are in row order; the padded part is cropped after the
+// inverse DWT.
+bool streamBand(const std::string& inPath, const std::string& outPath, int cols, int levels) {
+    const std::vector<std::pair<int, Subband>> order = pyramidCodingOrder(levels);
+    // Subband of (level, band), indexed (level - 1) * 4 + band
+    std::vector<int> subbandOf(static_cast<size_t>(levels) * 4, 0);
+    for (size_t s = 0; s < order.size(); ++s)
+        subbandOf[(order[s].first - 1) * 4 + static_cast<int>(order[s].second)] = static_cast<int>(s);
+
+    std::ofstream out(outPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error: Could not open " << outPath << " for writing." << std::endl;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<int>> blocks(order.size());
+    std::vector<uint8_t> chunkSubband;
+    std::vector<uint64_t> chunkOffset;
+    uint64_t offset = 0;
+    auto codeChunk = [&](size_t s) {
+        std::vector<int>& block = blocks[s];
+        if (block.empty()) return true;
+        std::vector<size_t> sizes = {block.size()};
+        std::vector<HuffmanCode> codes;
+        SegmentedBits bits;
+        if (!huffmanEncodeSegments(block, sizes, kMaxHuffmanStreams, codes, bits)) return false;
+        std::vector<uint8_t> chunk = serializeHuffmanSegments(codes, sizes, bits);
+        out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+        chunkSubband.push_back(static_cast<uint8_t>(s));
+        chunkOffset.push_back(offset);
+        offset += chunk.size();
+        block.clear();
+        if (!out) std::cerr << "❌ Failed to write " << outPath << std::endl;
+        return static_cast<bool>(out);
+    };
+
+    int rows = 0;
+    size_t windowBytes = 0;
+    if (!streamQuantizedRows(inPath, cols, levels, rows, windowBytes, [&](int level, Subband band, const int* row, int n) {
+            const size_t s = static_cast<size_t>(subbandOf[(level - 1) * 4 + static_cast<int>(band)]);
+            blocks[s].insert(blocks[s].end(), row, row + n);
+            return blocks[s].size() < kStreamChunkSymbols || codeChunk(s);
+        }))
+        return false;
+    size_t blockBytes = 0;
+    for (size_t s = 0; s < order.size(); ++s) {
+        blockBytes += blocks[s].capacity() * sizeof(int);
+        if (!codeChunk(s)) return false;
+    }
+
+    std::vector<uint8_t> tail;
+    BitWriter writer(tail);
+    for (size_t i = 0; i < chunkOffset.size(); ++i) {
+        writer.put(chunkSubband[i], 8);
+        writer.put(static_cast<uint32_t>(chunkOffset[i] >> 32), 32);
+        writer.put(static_cast<uint32_t>(chunkOffset[i]), 32);
+    }
+    writer.put(static_cast<uint32_t>(rows), 32);
+    writer.put(static_cast<uint32_t>(cols), 32);
+    writer.put(static_cast<uint32_t>(paddedToLevels(rows, levels)), 32);
+    writer.put(static_cast<uint32_t>(paddedToLevels(cols, levels)), 32);
+    writer.put(static_cast<uint32_t>(levels), 8);
+    writer.put(static_cast<uint32_t>(chunkOffset.size()), 32);
+    writer.put(static_cast<uint32_t>(offset >> 32), 32);
+    writer.put(static_cast<uint32_t>(offset), 32);
+    writer.finish();
+    out.write(reinterpret_cast<const char*>(tail.data()), static_cast<std::streamsize>(tail.size()));
+    if (!out.flush()) {
+        std::cerr << "❌ Failed to write " << outPath << std::endl;
+        return false;
+    }
+    const uint64_t fileBytes = offset + tail.size();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rawBytes = static_cast<double>(rows) * cols * sizeof(float);
+    std::cout << "[STREAM] " << inPath << ": " << rows << "x" << cols << " -> " << fileBytes << " bytes in "
+              << outPath << " (" << chunkOffset.size() << " chunks, "
+              << fileBytes * 8.0 / (static_cast<double>(rows) * cols) << " bpp, " << rawBytes / fileBytes
+              << "x vs raw float32)" << std::endl;
+    std::cout << "[STREAM] " << rawBytes / (1024.0 * 1024.0) / std::max(seconds, 1e-9)
+              << " MB/s in one pass, DWT window " << windowBytes / 1024.0 << " KB, chunk buffers "
+              << blockBytes / 1024.0 << " KB" << std::endl;
     return true;
 }
 
-// Quantize a subband in-place
-void quantize(std::vector<std::vector<float>>& band, float qstep) {
-    for (auto& row : band)
-        for (auto& v : row)
-            v = std::round(v / qstep);
+// Every data/band_N.bin present, in band order
+std::vector<std::string> cubeBandPaths() {
+    std::vector<std::string> paths;
+    for (int b = 0;; ++b) {
+        std::string path = "data/band_" + std::to_string(b) + ".bin";
+        if (!std::ifstream(path, std::ios::binary)) break;
+        paths.push_back(path);
+    }
+    return paths;
 }
 
-// Dequantize a subband in-place
-void dequantize(std::vector<std::vector<float>>& band, float qstep) {
-    for (auto& row : band)
-        for (auto& v : row)
-            v = v * qstep;
+// Compresses the whole cube with a 3D DWT (db4 along the bands, then spatially), so the
+// spectral correlation between neighbouring bands is removed before quantization.
+// Every subband of every plane gets its own Huffman table; written to output/encoded_cube.bin.
+int compressCube(int rows, int cols, int spatialLevels, ThreadPool& pool) {
+    std::vector<std::string> paths = cubeBandPaths();
+    const int bands = static_cast<int>(paths.size());
+    if (bands == 0) {
+        std::cerr << "❌ No data/band_*.bin files found." << std::endl;
+        return -1;
+    }
+
+    // Up to 3 spectral levels, keeping at least 4 bands at the last one; the band count is
+    // padded by repeating the last band (the spatial pyramid takes any size as is)
+    int spectralLevels = 1;
+    while (spectralLevels < 3 && bands >= (4 << spectralLevels)) ++spectralLevels;
+    const int spectralMultiple = 1 << spectralLevels;
+    const int paddedBands = std::max(4, (bands + spectralMultiple - 1) / spectralMultiple * spectralMultiple);
+
+    std::cout << "[CUBE] Loading " << bands << " bands of " << rows << "x" << cols << std::endl;
+    std::vector<Plane<float>> original;
+    for (const std::string& path : paths) {
+        int r = rows, c = cols;
+        Plane<float> band = loadBinImage(path, r, c);
+        if (band.empty()) return -1;
+        normalize(band);
+        original.push_back(std::move(band));
+    }
+
+    std::vector<Plane<float>> cube;
+    for (int b = 0; b < paddedBands; ++b)
+        cube.push_back(original[std::min(b, bands - 1)]);
+    std::cout << "[CUBE] " << spectralLevels << " spectral + " << spatialLevels << " spatial levels on "
+              << paddedBands << " x " << cube[0].rows() << " x " << cube[0].cols() << std::endl;
+
+    auto dwtStart = std::chrono::steady_clock::now();
+    if (!dwt3D(cube, spectralLevels, spatialLevels, DwtMethod::Lifting, &pool)) return -1;
+    std::cout << "[TIME] 3D DWT: " << nsPerPixel(dwtStart, paddedBands * cube[0].rows(), cube[0].cols())
+              << " ns/voxel" << std::endl;
+
+    // Planes are quantized with the spatial qstep table and coded in pyramid order. Spectral
+    // detail planes carry little energy, so their LL is quantized like the coarsest LH instead
+    // of with the fine LL step.
+    const std::vector<std::pair<int, Subband>> order = pyramidCodingOrder(spatialLevels);
+    const int spectralLow = paddedBands >> spectralLevels;
+    auto cubeQstep = [&](int plane, int level, Subband band) {
+        if (plane >= spectralLow && band == Subband::LL) return qstepFor(level, Subband::LH);
+        return qstepFor(level, band);
+    };
+    std::vector<int> flat_all;
+    flat_all.reserve(static_cast<size_t>(paddedBands) * cube[0].rows() * cube[0].cols());
+    for (int p = 0; p < paddedBands; ++p) {
+        for (const auto& [level, band] : order) {
+            PlaneView<float> sub = pyramidSubband(cube[p].view(), level, band);
+            quantize(sub, cubeQstep(p, level, band));
+            std::vector<int> flat = flatten(sub);
+            flat_all.insert(flat_all.end(), flat.begin(), flat.end());
+        }
+    }
+
+    // One table per subband of every plane (neighbours sharing where that is smaller), in the
+    // same stored form as the 2D paths
+    const std::vector<size_t> planeSizes = pyramidCodingSizes(cube[0].rows(), cube[0].cols(), spatialLevels);
+    std::vector<size_t> subbands;
+    for (int p = 0; p < paddedBands; ++p)
+        subbands.insert(subbands.end(), planeSizes.begin(), planeSizes.end());
+    std::vector<uint8_t> file = encodeSubbands(flat_all, subbands);
+    if (file.empty()) return -1;
+    std::vector<int> decoded = decodeSegments(file);
+    if (decoded.size() != flat_all.size()) {
+        std::cerr << "❌ Error: Huffman decode returned " << decoded.size() << " of "
+                  << flat_all.size() << " symbols." << std::endl;
+        return -1;
+    }
+
+    const int* next = decoded.data();
+    for (int p = 0; p < paddedBands; ++p) {
+        for (const auto& [level, band] : order) {
+            PlaneView<float> sub = pyramidSubband(cube[p].view(), level, band);
+            unflatten(next, sub);
+            dequantize(sub, cubeQstep(p, level, band));
+            next += static_cast<size_t>(sub.rows()) * sub.cols();
+        }
+    }
+    auto idwtStart = std::chrono::steady_clock::now();
+    if (!idwt3D(cube, spectralLevels, spatialLevels, DwtMethod::Lifting, &pool)) return -1;
+    std::cout << "[TIME] 3D IDWT: " << nsPerPixel(idwtStart, paddedBands * cube[0].rows(), cube[0].cols())
+              << " ns/voxel" << std::endl;
+
+    // Drop the padding bands before evaluating
+    std::vector<Plane<float>> reconstructed;
+    for (int b = 0; b < bands; ++b) {
+        reconstructed.push_back(std::move(cube[b]));
+        std::cout << "[CUBE] Band " << b << ": ";
+        evaluate(original[b], reconstructed[b]);
+    }
+
+    double bytes = static_cast<double>(file.size());
+    std::cout << "[CUBE] Encoded size: " << bytes << " bytes ("
+              << bytes * 8.0 / (static_cast<double>(bands) * rows * cols) << " bits/voxel)" << std::endl;
+    double meanSAM = computeMeanSAM(original, reconstructed);
+    std::cout << "[CUBE] Mean SAM (degrees): " << (meanSAM * 180.0 / M_PI) << std::endl;
+
+    return saveEncoded("output/encoded_cube.bin", file) ? 0 : -1;
 }
 
-// Print min/max and a small block (e.g., top-left 2x2) of a 2D matrix
-void printMatrixStats(const std::vector<std::vector<float>>& mat, const std::string& name) {
-    float minV = mat[0][0], maxV = mat[0][0];
-    for (const auto& row : mat)
-        for (float v : row) {
-            if (v < minV) minV = v;
-            if (v > maxV) maxV = v;
+// Lossless path: raw integer samples -> reversible 5/3 pyramid -> Huffman, checked to
+// round-trip bit-exactly. Writes output/lossless_band_N.bin; reports and failures go to `log`.
+int compressLossless(const std::string& inPath, int band, int rows, int cols, ThreadPool& pool, std::ostream& log) {
+    const int levels = 4;  // no quantization, so deeper pyramids only help
+
+    int r = rows, c = cols;
+    Plane<float> raw = loadBinImage(inPath, r, c);
+    if (raw.empty()) return -1;
+
+    Plane<int32_t> coeffs(rows, cols);
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            float v = raw(i, j);
+            if (v != std::round(v) || std::fabs(v) > (1 << 24)) {
+                log << "❌ " << inPath << " has non-integer samples; lossless mode needs integer data." << std::endl;
+                return -1;
+            }
+            coeffs(i, j) = static_cast<int32_t>(v);
+        }
+    }
+
+    // One plan serves both directions, so neither transform allocates
+    Dwt53Plan plan(rows, cols, levels, &pool);
+    if (!plan.valid()) return -1;
+    auto start = std::chrono::steady_clock::now();
+    if (!plan.forward(coeffs)) return -1;
+    log << "[TIME] " << levels << "-level 5/3 DWT: " << nsPerPixel(start, coeffs.rows(), coeffs.cols())
+        << " ns/pixel" << std::endl;
+
+    std::vector<int> flat_all;
+    flat_all.reserve(static_cast<size_t>(coeffs.rows()) * coeffs.cols());
+    for (const auto& [level, sb] : pyramidCodingOrder(levels)) {
+        PlaneView<int32_t> sub = pyramidSubband(coeffs.view(), level, sb);
+        for (int i = 0; i < sub.rows(); ++i)
+            flat_all.insert(flat_all.end(), sub.row(i), sub.row(i) + sub.cols());
+    }
+
+    std::vector<uint8_t> file = encodeSubbands(flat_all, pyramidCodingSizes(rows, cols, levels));
+    if (file.empty()) return -1;
+    std::vector<int> decoded = decodeSegments(file);
+    if (decoded.size() != flat_all.size()) {
+        log << "❌ Error: Huffman decode returned " << decoded.size() << " of "
+            << flat_all.size() << " symbols." << std::endl;
+        return -1;
+    }
+
+    Plane<int32_t> reconstructed(coeffs.rows(), coeffs.cols());
+    const int* next = decoded.data();
+    for (const auto& [level, sb] : pyramidCodingOrder(levels)) {
+        PlaneView<int32_t> sub = pyramidSubband(reconstructed.view(), level, sb);
+        for (int i = 0; i < sub.rows(); ++i, next += sub.cols())
+            std::copy(next, next + sub.cols(), sub.row(i));
+    }
+    start = std::chrono::steady_clock::now();
+    if (!plan.inverse(reconstructed)) return -1;
+    log << "[TIME] " << levels << "-level 5/3 IDWT: " << nsPerPixel(start, coeffs.rows(), coeffs.cols())
+        << " ns/pixel" << std::endl;
+
+    long long mismatches = 0;
+    for (int i = 0; i < rows; ++i)
+        for (int j = 0; j < cols; ++j)
+            mismatches += static_cast<float>(reconstructed(i, j)) != raw(i, j);
+    if (mismatches != 0) {
+        log << "❌ Lossless round trip failed: " << mismatches << " samples differ." << std::endl;
+        return -1;
+    }
+
+    double bytes = static_cast<double>(file.size());
+    double rawBytes = static_cast<double>(rows) * cols * sizeof(float);
+    log << "[LOSSLESS] Band " << band << ": bit-exact, " << bytes << " bytes ("
+        << bytes * 8.0 / (static_cast<double>(rows) * cols) << " bpp, " << rawBytes / bytes
+        << "x vs raw float32)" << std::endl;
+
+    return saveEncoded("output/lossless_band_" + std::to_string(band) + ".bin", file) ? 0 : -1;
+}
+
+// Fast preview: each band is quantized inside the DWT, Huffman coded and decoded from its
+// stored form, then reconstructed by the fused dequantize + IDWT path directly into normalized 8-bit pixels.
+int writePreview(const std::vector<Plane<float>>& channels, DwtPlan& plan,
+                 const std::vector<float>& steps, const std::string& path) {
+    Plane<float> work(plan.rows(), plan.cols());
+    std::vector<Plane<uint8_t>> preview;
+    std::vector<int> symbols(static_cast<size_t>(plan.rows()) * plan.cols());
+
+    for (const Plane<float>& channel : channels) {
+        work = channel;
+        if (!plan.forwardQuantized(work, steps.data(), symbols.data())) return -1;
+
+        std::vector<uint8_t> file = encodeSubbands(symbols, pyramidCodingSizes(plan.rows(), plan.cols(), plan.levels()));
+        if (file.empty()) return -1;
+        std::vector<int> decoded = decodeSegments(file);
+        if (decoded.size() != symbols.size()) {
+            std::cerr << "❌ Error: Huffman decode returned " << decoded.size() << " of "
+                      << symbols.size() << " symbols." << std::endl;
+            return -1;
         }
-    std::cout << "----------------------------------------" << std::endl;
-    std::cout << "[" << name << "]" << std::endl;
-    std::cout << "  min: " << minV << ", max: " << maxV << std::endl;
-    std::cout << "  Top-left 2x2 block:" << std::endl;
-    for (int i = 0; i < std::min(2, (int)mat.size()); ++i) {
-        std::cout << "    ";
-        for (int j = 0; j < std::min(2, (int)mat[0].size()); ++j) {
-            std::cout << std::setw(8) << std::fixed << std::setprecision(2) << mat[i][j] << " ";
+
+        Plane<uint8_t> pixels(plan.rows(), plan.cols());
+        auto start = std::chrono::steady_clock::now();
+        if (!plan.inverseDequantized8(decoded.data(), steps.data(), work, pixels, PixelMapping::Normalize))
+            return -1;
+        std::cout << "[TIME] Preview reconstruct: " << nsPerPixel(start, plan.rows(), plan.cols())
+                  << " ns/pixel" << std::endl;
+        preview.push_back(std::move(pixels));
+    }
+
+    saveColorImage(preview[0], preview[1], preview[2], path);
+    std::cout << "✅ Preview saved to " << path << std::endl;
+    return 0;
+}
+
+// Quicklook: bands are coded as usual, then decoding stops at pyramid level `level` (0 = full
+// size). The reader parses the header, takes from the jump table the byte span of the leading
+// segments (the subbands of the coarser levels), decodes only those, and runs only that level's
+// inverse steps. Writes output/quicklook_L<level>.png.
+int writeQuicklook(const std::vector<Plane<float>>& channels, DwtPlan& plan, const std::vector<float>& steps,
+                   int level) {
+    Plane<float> work(plan.rows(), plan.cols());
+    std::vector<int> symbols(static_cast<size_t>(plan.rows()) * plan.cols());
+    std::vector<Plane<float>> looks;
+    // Known from the dimensions and depth alone, as a reader would know it
+    const size_t needed = plan.approximationSymbols(level);
+
+    for (const Plane<float>& channel : channels) {
+        work = channel;
+        if (!plan.forwardQuantized(work, steps.data(), symbols.data())) return -1;
+        // Unmerged, so no table spans the cut between the levels read and those skipped
+        std::vector<uint8_t> file = encodeSubbands(symbols, pyramidCodingSizes(plan.rows(), plan.cols(), plan.levels()),
+                                                   false);
+        if (file.empty()) return -1;
+
+        // Segments follow coding order, coarse to fine, so a reader can stop after the ones
+        // holding the first `needed` symbols
+        auto start = std::chrono::steady_clock::now();
+        std::vector<HuffmanCode> codes;
+        std::vector<size_t> sizes;
+        SegmentedBits prefix;
+        size_t headerBytes = 0;
+        if (!deserializeHuffmanSegments(file.data(), file.size(), codes, sizes, prefix, &headerBytes, needed))
+            return -1;
+        const size_t prefixBytes = headerBytes + prefix.bytes.size();
+        // The decode stops after `needed` symbols; the readers report how many bits that took
+        uint64_t bitsRead = 0;
+        std::vector<int> decoded = huffmanDecodeSegments(prefix, codes, sizes, needed, &bitsRead);
+        if (decoded.size() != needed) {
+            std::cerr << "❌ Error: Huffman decode returned " << decoded.size() << " of " << needed
+                      << " symbols." << std::endl;
+            return -1;
         }
-        std::cout << std::endl;
+        Plane<float> look(pyramidExtent(plan.rows(), level), pyramidExtent(plan.cols(), level));
+        if (!plan.inverseApproximation(decoded.data(), steps.data(), level, look)) return -1;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "[QUICKLOOK] Level " << level << " (" << look.rows() << "x" << look.cols() << "): "
+                  << prefixBytes << " of " << file.size() << " bytes ("
+                  << 100.0 * prefixBytes / std::max<size_t>(file.size(), 1) << "%, " << sizes.size()
+                  << " leading segments), " << bitsRead << " bits decoded, " << needed << " of "
+                  << symbols.size() << " symbols" << std::endl;
+        std::cout << "[TIME] Quicklook decode: " << ms << " ms" << std::endl;
+        looks.push_back(std::move(look));
     }
-    std::cout << "----------------------------------------" << std::endl;
+
+    std::string path = "output/quicklook_L" + std::to_string(level) + ".png";
+    saveColorImage(looks[0], looks[1], looks[2], path);
+    std::cout << "✅ Quicklook saved to " << path << std::endl;
+    return 0;
 }
 
-int main() {
+// Viewer-style window decode: bands are coded as usual, then only the window [r0, r0 + h) x
+// [c0, c0 + w) is reconstructed from the decoded symbols, next to a full reconstruction for
+// comparison. Writes output/roi_image.png.
+int decodeRegion(const std::vector<Plane<float>>& channels, DwtPlan& plan, const std::vector<float>& steps,
+                 int r0, int c0, int h, int w) {
+    Plane<float> work(plan.rows(), plan.cols());
+    std::vector<int> symbols(static_cast<size_t>(plan.rows()) * plan.cols());
+    std::vector<Plane<float>> windows;
+
+    for (const Plane<float>& channel : channels) {
+        work = channel;
+        if (!plan.forwardQuantized(work, steps.data(), symbols.data())) return -1;
+
+        std::vector<uint8_t> file = encodeSubbands(symbols, pyramidCodingSizes(plan.rows(), plan.cols(), plan.levels()));
+        if (file.empty()) return -1;
+        std::vector<int> decoded = decodeSegments(file);
+        if (decoded.size() != symbols.size()) {
+            std::cerr << "❌ Error: Huffman decode returned " << decoded.size() << " of "
+                      << symbols.size() << " symbols." << std::endl;
+            return -1;
+        }
+
+        Plane<float> window(h, w);
+        long long used = 0;
+        auto start = std::chrono::steady_clock::now();
+        if (!plan.inverseRegionDequantized(decoded.data(), steps.data(), r0, c0, window, &used)) return -1;
+        double roiMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        if (!plan.inverseDequantized(decoded.data(), steps.data(), work)) return -1;
+        double fullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        float maxDiff = 0.0f;
+        for (int i = 0; i < h; ++i)
+            for (int j = 0; j < w; ++j)
+                maxDiff = std::max(maxDiff, std::fabs(window(i, j) - work(r0 + i, c0 + j)));
+        std::cout << "[ROI] " << h << "x" << w << " at (" << r0 << ", " << c0 << "): " << used << " of "
+                  << symbols.size() << " coefficients, max diff vs full decode " << maxDiff << std::endl;
+        std::cout << "[TIME] ROI IDWT: " << roiMs << " ms, full IDWT: " << fullMs << " ms" << std::endl;
+        windows.push_back(std::move(window));
+    }
+
+    saveColorImage(windows[0], windows[1], windows[2], "output/roi_image.png");
+    std::cout << "✅ Window saved to output/roi_image.png" << std::endl;
+    return 0;
+}
+
+// Full round trip of one band: fused DWT + quantize, Huffman encode/decode, fused dequantize +
+// IDWT, metrics and the encoded file. Everything it reports goes to `log`, so bands can run as
+// parallel tasks and still print in band order.
+int compressChannel(int c, const Plane<float>& channel, DwtPlan& plan, const std::vector<float>& steps,
+                    std::ostream& log, Plane<float>& result) {
+    const int levels = plan.levels();
+    const std::vector<std::pair<int, Subband>> order = pyramidCodingOrder(levels);
+    std::vector<int> flat_all(static_cast<size_t>(plan.rows()) * plan.cols());
+
+    log << "\n=== Processing Channel " << c << " ===" << std::endl;
+    Plane<float> image = channel;
+
+    log << "[DEBUG] Original image size: " << image.rows() << " x " << image.cols() << std::endl;
+
+    // --- N-level DWT fused with adaptive quantization: each subband tile is quantized and
+    // written to its place in flat_all (pyramidCodingOrder: the coarsest LL, then each level's
+    // LH, HL, HH from coarse to fine) as soon as it is final ---
+    Plane<float> coeffs = image;
+    auto dwtStart = std::chrono::steady_clock::now();
+    if (!plan.forwardQuantized(coeffs, steps.data(), flat_all.data())) return -1;
+    log << "[TIME] " << levels << "-level DWT + quantize: " << nsPerPixel(dwtStart, image.rows(), image.cols())
+        << " ns/pixel" << std::endl;
+    for (const auto& [level, band] : order)
+        printMatrixStats(log, pyramidSubband(coeffs.view(), level, band), subbandName(level, band) + " after DWT");
+
+    // The coarsest LL, LH, HL, HH lead the symbol buffer
+    PlaneView<float> coarse[4];
+    for (int b = 0; b < 4; ++b)
+        coarse[b] = pyramidSubband(coeffs.view(), levels, static_cast<Subband>(b));
+    const size_t llCount = static_cast<size_t>(coarse[0].rows()) * coarse[0].cols();
+    const size_t hhOffset = llCount + static_cast<size_t>(coarse[1].rows()) * coarse[1].cols()
+                            + static_cast<size_t>(coarse[2].rows()) * coarse[2].cols();
+    printMatrixStats(log, PlaneView<const int>(flat_all.data(), coarse[0].rows(), coarse[0].cols(), coarse[0].cols()),
+                     subbandName(levels, Subband::LL) + " quantized");
+    printMatrixStats(log, PlaneView<const int>(flat_all.data() + hhOffset, coarse[3].rows(), coarse[3].cols(), coarse[3].cols()),
+                     subbandName(levels, Subband::HH) + " quantized");
+
+    // Every subband is counted once; the diagnostics below and the coder share these counts
+    const std::vector<size_t> subbandSizes = pyramidCodingSizes(plan.rows(), plan.cols(), levels);
+    std::vector<Histogram> hists;
+    if (!countSegments(flat_all, subbandSizes, hists)) return -1;
+
+    // Analyze the quantized coarsest LL values (the first subband in coding order):
+    Histogram hist = hists[0];
+    log << "[DEBUG] LL" << levels << " quantized min: " << hist.minSymbol() << ", max: " << hist.maxSymbol() << std::endl;
+    log << "[DEBUG] LL" << levels << " histogram (first 10):" << std::endl;
+    int count = 0;
+    for (int val = hist.minSymbol(); val <= hist.maxSymbol() && count < 10; ++val) {
+        if (!hist[val]) continue;
+        log << "  Value: " << val << " Freq: " << hist[val] << std::endl;
+        ++count;
+    }
+
+    // --- Huffman encode, one table per subband (neighbours share one where that is smaller),
+    // each subband split into interleaved streams for the decoder ---
+    for (size_t s = 1; s < hists.size(); ++s)
+        if (!hist.add(hists[s])) return -1;  // whole-band counts, for the frequency table
+    const std::vector<size_t> sizes = mergeHuffmanSegments(subbandSizes, hists);
+    std::vector<HuffmanCode> codes;
+    SegmentedBits encoded;
+    if (!huffmanEncodeSegments(flat_all, sizes, hists, kMaxHuffmanStreams, codes, encoded)) return -1;
+
+    // --- Huffman process visualization ---
+    log << "  [Huffman] Frequency table (top 10):" << std::endl;
+    std::vector<std::pair<int, uint64_t>> freq_vec;
+    freq_vec.reserve(hist.distinct());
+    for (int val = hist.minSymbol(); val <= hist.maxSymbol(); ++val)
+        if (hist[val]) freq_vec.emplace_back(val, hist[val]);
+    std::stable_sort(freq_vec.begin(), freq_vec.end(), [](auto& a, auto& b) { return b.second > a.second; });
+    for (size_t i = 0; i < std::min<size_t>(10, freq_vec.size()); ++i) {
+        log << "    Value: " << freq_vec[i].first << " Freq: " << freq_vec[i].second << std::endl;
+    }
+
+    const HuffmanCode& code = codes[0];
+    log << "  [Huffman] First table (top 10):" << std::endl;
+    int code_count = 0;
+    for (int k = 0; k < code.symbolCount() && code_count < 10; ++k) {
+        if (!code.lengths[k]) continue;
+        log << "    Value: " << code.minSymbol + k << " Code: " << bitString(code.codes[k], code.lengths[k]) << std::endl;
+        ++code_count;
+    }
+
+    log << "  [Huffman] Encoded bitstream (first 64 bits): "
+        << bitString(encoded.bytes, encoded.streamBits[0], 64) << std::endl;
+    log << "  [Huffman] Encoded bitstream length: " << encoded.bitCount() << " bits in "
+        << encoded.streamBits.size() << " streams" << std::endl;
+
+    // Stored form: every subband's code-length table + bits, enough for another process to decode
+    std::vector<uint8_t> file = serializeHuffmanSegments(codes, sizes, encoded);
+    log << "  [Huffman] Header: " << file.size() - encoded.bytes.size() << " bytes ("
+        << codes.size() << " tables)" << std::endl;
+
+    int longest = 0;
+    size_t subband = 0;
+    for (size_t s = 0; s < codes.size(); ++s) {
+        // The subbands this table covers
+        std::string names;
+        for (size_t covered = 0; covered < sizes[s]; covered += subbandSizes[subband++])
+            names += (names.empty() ? "" : "+") + subbandName(order[subband].first, order[subband].second);
+        // The code was built from hists[s], so its lengths line up with those counts
+        uint64_t segmentBits = 0;
+        for (int k = 0; k < codes[s].symbolCount(); ++k) {
+            segmentBits += hists[s].counts()[k] * codes[s].lengths[k];
+            longest = std::max(longest, static_cast<int>(codes[s].lengths[k]));
+        }
+        log << "  [Huffman] " << names << ": " << sizes[s] << " symbols, "
+            << static_cast<double>(segmentBits) / std::max<size_t>(sizes[s], 1) << " bits/symbol" << std::endl;
+    }
+    double avg_code_len = static_cast<double>(encoded.bitCount()) / flat_all.size();
+    log << "  [Huffman] Average code length: " << avg_code_len << " bits/symbol" << std::endl;
+    log << "  [Huffman] Longest code: " << longest << " bits (limit " << kDefaultHuffmanLimit << ")" << std::endl;
+
+    // --- Huffman decode, from the stored bytes alone (only the decode itself is timed) ---
+    std::vector<HuffmanCode> storedCodes;
+    std::vector<size_t> storedSizes;
+    SegmentedBits stored;
+    if (!deserializeHuffmanSegments(file.data(), file.size(), storedCodes, storedSizes, stored)) return -1;
+    auto decodeStart = std::chrono::steady_clock::now();
+    std::vector<int> decoded = huffmanDecodeSegments(stored, storedCodes, storedSizes);
+    std::chrono::duration<double, std::nano> decodeTime = std::chrono::steady_clock::now() - decodeStart;
+    log << "[TIME] Huffman decode: " << decodeTime.count() / std::max<size_t>(decoded.size(), 1)
+        << " ns/symbol (" << encoded.streams << " streams per table)" << std::endl;
+    if (decoded.size() != flat_all.size()) {
+        log << "❌ Error: Huffman decode returned " << decoded.size() << " of "
+            << flat_all.size() << " symbols." << std::endl;
+        return -1;
+    }
+
+    // --- Reconstruct straight from the decoded symbols: dequantization happens while each
+    // level's first inverse stage loads its subbands ---
+    Plane<float> reconstructed(coeffs.rows(), coeffs.cols());
+    auto idwtStart = std::chrono::steady_clock::now();
+    if (!plan.inverseDequantized(decoded.data(), steps.data(), reconstructed)) return -1;
+    log << "[TIME] Dequantize + " << levels << "-level IDWT: "
+        << nsPerPixel(idwtStart, reconstructed.rows(), reconstructed.cols()) << " ns/pixel" << std::endl;
+
+    // Print and normalize value range before saving
+    float minVal, maxVal;
+    planeMinMax(reconstructed, minVal, maxVal);
+    log << "[DEBUG] Reconstructed min: " << minVal << " max: " << maxVal << std::endl;
+    if (maxVal > minVal && (minVal < 0.0f || maxVal > 255.0f)) {
+        log << "[DEBUG] Normalizing reconstructed channel to [0,255]" << std::endl;
+        normalize(reconstructed);
+    }
+
+    // --- Normalize both images to [0,255] for fair evaluation ---
+    normalize(image);
+    normalize(reconstructed);
+
+    log << "[5] Evaluating..." << std::endl;
+    evaluate(image, reconstructed, log);
+    double ssim = computeSSIM(image, reconstructed);
+    log << "SSIM: " << ssim << std::endl;
+
+    double originalSize = static_cast<double>(flat_all.size()) * sizeof(int);
+    double compressedSize = static_cast<double>(file.size()); // header + bits, in bytes
+    double cr = compressedSize > 0.0 ? originalSize / compressedSize : 0.0;
+    double bpp = (compressedSize * 8.0) / (static_cast<double>(image.rows()) * image.cols());
+
+    log << "Compression Ratio (CR): " << cr << std::endl;
+    log << "Bits Per Pixel (BPP): " << bpp << std::endl;
+
+    // Save Huffman encoded bin file
+    if (!saveEncoded("output/encoded_band_" + std::to_string(c) + ".bin", file)) return -1;
+
+    result = std::move(reconstructed);
+    return 0;
+}
+
+int main(int argc, char** argv) {
     std::string outputPath = "output/reconstructed_image.png";
     std::string bandPaths[3] = {
         "data/band_0.bin",
@@ -106,30 +869,46 @@ int main() {
     }
     std::cout << "[INFO] Detected image size: " << rows << "x" << cols << std::endl;
 
+    // --- Pyramid depth; larger scenes compact energy better with 4-6 levels ---
+    const int levels = 2;
+
+    // --stream: one pass of line-based DWT, quantization and chunked Huffman coding, never holding a whole band
+    if (argc > 1 && std::string(argv[1]) == "--stream") {
+        for (int c = 0; c < 3; ++c) {
+            if (!streamBand(bandPaths[c], "output/stream_band_" + std::to_string(c) + ".bin", cols, levels))
+                return -1;
+        }
+        return 0;
+    }
+
+    // --cube: 3D DWT over every band in data/ instead of three independent RGB bands
+    if (argc > 1 && std::string(argv[1]) == "--cube") {
+        ThreadPool pool;
+        return compressCube(rows, cols, levels, pool);
+    }
+
+    // --lossless: reversible integer 5/3 transform, bit-exact round trip of the raw samples
+    if (argc > 1 && std::string(argv[1]) == "--lossless") {
+        ThreadPool pool;
+        return runBandTasks(pool, 3, [&](int c, std::ostream& log) {
+            return compressLossless(bandPaths[c], c, rows, cols, pool, log);
+        });
+    }
+
     std::cout << "[1] Loading raw hyperspectral bands..." << std::endl;
-    std::vector<std::vector<float>> R = loadBinImage(bandPaths[0], rows, cols);
-    std::vector<std::vector<float>> G = loadBinImage(bandPaths[1], rows, cols);
-    std::vector<std::vector<float>> B = loadBinImage(bandPaths[2], rows, cols);
+    Plane<float> R = loadBinImage(bandPaths[0], rows, cols);
+    Plane<float> G = loadBinImage(bandPaths[1], rows, cols);
+    Plane<float> B = loadBinImage(bandPaths[2], rows, cols);
+    if (R.empty() || G.empty() || B.empty()) {
+        std::cerr << "❌ Failed to load input bands." << std::endl;
+        return -1;
+    }
 
-    printMatrixStats(R, "Raw Band R");
-    printMatrixStats(G, "Raw Band G");
-    printMatrixStats(B, "Raw Band B");
+    printMatrixStats(std::cout, R, "Raw Band R");
+    printMatrixStats(std::cout, G, "Raw Band G");
+    printMatrixStats(std::cout, B, "Raw Band B");
 
     // Normalize each band to [0,255] before saving as an image
-    auto normalize = [](std::vector<std::vector<float>>& img) {
-        float minVal = img[0][0], maxVal = img[0][0];
-        for (const auto& row : img)
-            for (float v : row) {
-                if (v < minVal) minVal = v;
-                if (v > maxVal) maxVal = v;
-            }
-        if (maxVal > minVal) {
-            for (auto& row : img)
-                for (float& v : row)
-                    v = 255.0f * (v - minVal) / (maxVal - minVal);
-        }
-    };
-
     normalize(R);
     normalize(G);
     normalize(B);
@@ -137,250 +916,76 @@ int main() {
     saveColorImage(R, G, B, "output/original_image.png");
     std::cout << "Original image saved as output/original_image.png" << std::endl;
 
-    if (R.size() != (size_t)rows || G.size() != (size_t)rows || B.size() != (size_t)rows ||
-        R[0].size() != (size_t)cols || G[0].size() != (size_t)cols || B[0].size() != (size_t)cols) {
+    if (R.rows() != rows || G.rows() != rows || B.rows() != rows ||
+        R.cols() != cols || G.cols() != cols || B.cols() != cols) {
         std::cerr << "❌ Loaded images have inconsistent sizes." << std::endl;
         return -1;
     }
 
-    std::vector<std::vector<std::vector<float>>> channels = {R, G, B};
-    std::vector<std::vector<std::vector<float>>> channels_reconstructed;
-
-    // --- Adaptive Quantization: set different qsteps for each subband ---
-    float q_LL2  = 0.2f;
-    float q_LH2  = 2.0f;
-    float q_HL2  = 2.0f;
-    float q_HH2  = 10.0f;
-    float q_LH1  = 5.0f;
-    float q_HL1  = 5.0f;
-    float q_HH1  = 20.0f;
-
-    for (int c = 0; c < 3; ++c) {
-        std::cout << "\n=== Processing Channel " << c << " ===" << std::endl;
-        auto image = channels[c];
-
-        std::cout << "[DEBUG] Original image size: " << image.size() << " x " << image[0].size() << std::endl;
-        padToEven(image);
-        if (!checkRowSizes(image, "Image")) return -1;
-        std::cout << "[DEBUG] Padded image size: " << image.size() << " x " << image[0].size() << std::endl;
-
-        // Level 1 DWT
-        padToEven(image); // Ensure even before DWT
-        if (!checkRowSizes(image, "Image before Level 1 DWT")) return -1;
-        std::vector<std::vector<float>> LL1, LH1, HL1, HH1;
-        dwt2D_db4(image, LL1, LH1, HL1, HH1);
-        if (LL1.empty() || LL1[0].empty()) {
-            std::cerr << "❌ Error: LL1 is empty after DWT!" << std::endl;
-            return -1;
-        }
-        printMatrixStats(LL1, "LL1 after L1 DWT");
-        printMatrixStats(LH1, "LH1 after L1 DWT");
-        printMatrixStats(HL1, "HL1 after L1 DWT");
-        printMatrixStats(HH1, "HH1 after L1 DWT");
-
-        // Pad all subbands after first DWT
-        padToEven(LL1);
-        padToEven(LH1);
-        padToEven(HL1);
-        padToEven(HH1);
-        if (!checkRowSizes(LL1, "LL1 after padding")) return -1;
-        if (!checkRowSizes(LH1, "LH1 after padding")) return -1;
-        if (!checkRowSizes(HL1, "HL1 after padding")) return -1;
-        if (!checkRowSizes(HH1, "HH1 after padding")) return -1;
-        std::cout << "[DEBUG] LL1 size after padding: "
-                  << LL1.size() << "x" << (LL1.empty() ? 0 : LL1[0].size()) << std::endl;
-
-        // Level 2 DWT
-        padToEven(LL1); // Ensure even before DWT
-        if (!checkRowSizes(LL1, "LL1 before Level 2 DWT")) return -1;
-        std::vector<std::vector<float>> LL2, LH2, HL2, HH2;
-        dwt2D_db4(LL1, LL2, LH2, HL2, HH2);
-        if (LL2.empty() || LL2[0].empty()) {
-            std::cerr << "❌ Error: LL2 is empty after DWT!" << std::endl;
+    std::vector<Plane<float>> channels;
+    channels.push_back(std::move(R));
+    channels.push_back(std::move(G));
+    channels.push_back(std::move(B));
+
+    const std::vector<std::pair<int, Subband>> order = pyramidCodingOrder(levels);
+
+    // Lifting evaluates the same db4 filter bank with about half the arithmetic and no padded copies.
+    // --wavelet <name> swaps in a compile-time filter bank instead (db2..db20, cdf97, legall53).
+    const DwtMethod dwtMethod = DwtMethod::Lifting;
+    bool useFilterBank = false;
+    Wavelet wavelet = Wavelet::Db4;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) != "--wavelet") continue;
+        if (!parseWavelet(argv[i + 1], wavelet)) {
+            std::cerr << "❌ Unknown wavelet: " << argv[i + 1] << std::endl;
             return -1;
         }
-        printMatrixStats(LL2, "LL2 after L2 DWT");
-        printMatrixStats(LH2, "LH2 after L2 DWT");
-        printMatrixStats(HL2, "HL2 after L2 DWT");
-        printMatrixStats(HH2, "HH2 after L2 DWT");
-        std::cout << "[DEBUG] LL2 size: " << LL2.size() << " x " << LL2[0].size() << std::endl;
-
-        // --- Adaptive Quantization ---
-        quantize(LL2, q_LL2);
-        quantize(LH2, q_LH2);
-        quantize(HL2, q_HL2);
-        quantize(HH2, q_HH2);
-        quantize(LH1, q_LH1);
-        quantize(HL1, q_HL1);
-        quantize(HH1, q_HH1);
-        printMatrixStats(LL2, "LL2 quantized");
-        printMatrixStats(HH2, "HH2 quantized");
-
-        // --- Flatten and concatenate all subbands (LL2, LH2, HL2, HH2, LH1, HL1, HH1) ---
-        std::vector<int> flat_LL2 = flatten(LL2);
-        std::vector<int> flat_LH2 = flatten(LH2);
-        std::vector<int> flat_HL2 = flatten(HL2);
-        std::vector<int> flat_HH2 = flatten(HH2);
-        std::vector<int> flat_LH1 = flatten(LH1);
-        std::vector<int> flat_HL1 = flatten(HL1);
-        std::vector<int> flat_HH1 = flatten(HH1);
-
-        // Add this block here to analyze LL2 quantized values:
-        int minQ = flat_LL2[0], maxQ = flat_LL2[0];
-        std::unordered_map<int, int> hist;
-        for (int v : flat_LL2) {
-            if (v < minQ) minQ = v;
-            if (v > maxQ) maxQ = v;
-            hist[v]++;
-        }
-        std::cout << "[DEBUG] LL2 quantized min: " << minQ << ", max: " << maxQ << std::endl;
-        std::cout << "[DEBUG] LL2 histogram (first 10):" << std::endl;
-        int count = 0;
-        for (auto& [val, freq] : hist) {
-            std::cout << "  Value: " << val << " Freq: " << freq << std::endl;
-            if (++count >= 10) break;
-        }
-
-        // Store sizes for splitting during decoding
-        size_t sz_LL2 = flat_LL2.size();
-        size_t sz_LH2 = flat_LH2.size();
-        size_t sz_HL2 = flat_HL2.size();
-        size_t sz_HH2 = flat_HH2.size();
-        size_t sz_LH1 = flat_LH1.size();
-        size_t sz_HL1 = flat_HL1.size();
-        size_t sz_HH1 = flat_HH1.size();
-
-        // Concatenate all
-        std::vector<int> flat_all;
-        flat_all.reserve(sz_LL2 + sz_LH2 + sz_HL2 + sz_HH2 + sz_LH1 + sz_HL1 + sz_HH1);
-        flat_all.insert(flat_all.end(), flat_LL2.begin(), flat_LL2.end());
-        flat_all.insert(flat_all.end(), flat_LH2.begin(), flat_LH2.end());
-        flat_all.insert(flat_all.end(), flat_HL2.begin(), flat_HL2.end());
-        flat_all.insert(flat_all.end(), flat_HH2.begin(), flat_HH2.end());
-        flat_all.insert(flat_all.end(), flat_LH1.begin(), flat_LH1.end());
-        flat_all.insert(flat_all.end(), flat_HL1.begin(), flat_HL1.end());
-        flat_all.insert(flat_all.end(), flat_HH1.begin(), flat_HH1.end());
-
-        // --- Huffman encode ---
-        std::unordered_map<int, std::string> huffTable;
-        std::string encoded = huffmanEncode(flat_all, huffTable);
-
-        // --- Huffman process visualization ---
-        std::cout << "  [Huffman] Frequency table (top 10):" << std::endl;
-        std::unordered_map<int, int> freq;
-        for (int v : flat_all) freq[v]++;
-        std::vector<std::pair<int, int>> freq_vec(freq.begin(), freq.end());
-        std::sort(freq_vec.begin(), freq_vec.end(), [](auto& a, auto& b) { return b.second > a.second; });
-        for (size_t i = 0; i < std::min<size_t>(10, freq_vec.size()); ++i) {
-            std::cout << "    Value: " << freq_vec[i].first << " Freq: " << freq_vec[i].second << std::endl;
-        }
-
-        std::cout << "  [Huffman] Code table (top 10):" << std::endl;
-        int code_count = 0;
-        for (const auto& [val, code] : huffTable) {
-            std::cout << "    Value: " << val << " Code: " << code << std::endl;
-            if (++code_count >= 10) break;
-        }
-
-        std::cout << "  [Huffman] Encoded bitstream (first 64 bits): " << encoded.substr(0, 64) << std::endl;
-        std::cout << "  [Huffman] Encoded bitstream length: " << encoded.size() << " bits" << std::endl;
-
-        double avg_code_len = 0.0;
-        for (const auto& [val, code] : huffTable) {
-            avg_code_len += code.length() * freq[val];
-        }
-        avg_code_len /= flat_all.size();
-        std::cout << "  [Huffman] Average code length: " << avg_code_len << " bits/symbol" << std::endl;
-
-        // --- Huffman decode ---
-        std::unordered_map<std::string, int> reverseTable;
-        for (const auto& [val, code] : huffTable) reverseTable[code] = val;
-        std::vector<int> decoded = huffmanDecode(encoded, reverseTable, flat_all.size());
-
-        // --- Split decoded data back into subbands ---
-        std::vector<int>::const_iterator it = decoded.begin();
-        std::vector<std::vector<float>> rec_LL2 = unflatten(std::vector<int>(it, it + sz_LL2), LL2.size(), LL2[0].size()); it += sz_LL2;
-        std::vector<std::vector<float>> rec_LH2 = unflatten(std::vector<int>(it, it + sz_LH2), LH2.size(), LH2[0].size()); it += sz_LH2;
-        std::vector<std::vector<float>> rec_HL2 = unflatten(std::vector<int>(it, it + sz_HL2), HL2.size(), HL2[0].size()); it += sz_HL2;
-        std::vector<std::vector<float>> rec_HH2 = unflatten(std::vector<int>(it, it + sz_HH2), HH2.size(), HH2[0].size()); it += sz_HH2;
-        std::vector<std::vector<float>> rec_LH1 = unflatten(std::vector<int>(it, it + sz_LH1), LH1.size(), LH1[0].size()); it += sz_LH1;
-        std::vector<std::vector<float>> rec_HL1 = unflatten(std::vector<int>(it, it + sz_HL1), HL1.size(), HL1[0].size()); it += sz_HL1;
-        std::vector<std::vector<float>> rec_HH1 = unflatten(std::vector<int>(it, it + sz_HH1), HH1.size(), HH1[0].size()); it += sz_HH1;
-
-        // --- Adaptive Dequantization ---
-        dequantize(rec_LL2, q_LL2);
-        dequantize(rec_LH2, q_LH2);
-        dequantize(rec_HL2, q_HL2);
-        dequantize(rec_HH2, q_HH2);
-        dequantize(rec_LH1, q_LH1);
-        dequantize(rec_HL1, q_HL1);
-        dequantize(rec_HH1, q_HH1);
-
-        // --- Reconstruct using all subbands ---
-        std::vector<std::vector<float>> reconstructed_LL1 = idwt2D_db4(
-            rec_LL2, rec_LH2, rec_HL2, rec_HH2);
-
-        std::vector<std::vector<float>> reconstructed = idwt2D_db4(
-            reconstructed_LL1, rec_LH1, rec_HL1, rec_HH1);
-
-        // Print and normalize value range before saving
-        float minVal = reconstructed[0][0], maxVal = reconstructed[0][0];
-        for (const auto& row : reconstructed)
-            for (float v : row) {
-                if (v < minVal) minVal = v;
-                if (v > maxVal) maxVal = v;
-            }
-        std::cout << "[DEBUG] Reconstructed min: " << minVal << " max: " << maxVal << std::endl;
-        if (maxVal > minVal && (minVal < 0.0f || maxVal > 255.0f)) {
-            std::cout << "[DEBUG] Normalizing reconstructed channel to [0,255]" << std::endl;
-            for (auto& row : reconstructed)
-                for (float& v : row)
-                    v = 255.0f * (v - minVal) / (maxVal - minVal);
-        }
-
-        // --- Normalize both images to [0,255] for fair evaluation ---
-        auto normalize = [](std::vector<std::vector<float>>& img) {
-            float minVal = img[0][0], maxVal = img[0][0];
-            for (const auto& row : img)
-                for (float v : row) {
-                    if (v < minVal) minVal = v;
-                    if (v > maxVal) maxVal = v;
-                }
-            if (maxVal > minVal) {
-                for (auto& row : img)
-                    for (float& v : row)
-                        v = 255.0f * (v - minVal) / (maxVal - minVal);
-            }
-        };
-        normalize(image);
-        normalize(reconstructed);
-
-        std::cout << "[5] Evaluating..." << std::endl;
-        evaluate(image, reconstructed);
-        double ssim = computeSSIM(image, reconstructed);
-        std::cout << "SSIM: " << ssim << std::endl;
-
-        double originalSize = static_cast<double>(flat_all.size()) * sizeof(int);
-        double compressedSize = static_cast<double>(encoded.size()) / 8.0; // bits to bytes
-        double cr = compressedSize > 0.0 ? originalSize / compressedSize : 0.0;
-        double bpp = (compressedSize * 8.0) / (image.size() * image[0].size());
+        useFilterBank = true;
+    }
+    std::cout << "[INFO] Wavelet: " << (useFilterBank ? waveletName(wavelet) : "db4 (lifting)") << std::endl;
+    std::cout << "[INFO] DWT kernels: " << dwtKernelIsa() << std::endl;
 
-        std::cout << "Compression Ratio (CR): " << cr << std::endl;
-        std::cout << "Bits Per Pixel (BPP): " << bpp << std::endl;
+    // Bands run as parallel tasks, and each band's DWT/IDWT is spread over every hardware thread
+    ThreadPool pool;
+    std::cout << "[INFO] DWT threads: " << pool.size() << std::endl;
 
-        // Save Huffman encoded bin file
-        std::string binFile = "output/encoded_band_" + std::to_string(c) + ".bin";
-        std::ofstream out(binFile, std::ios::binary);
-        if (!out) {
-            std::cerr << "Error: Could not open " << binFile << " for writing." << std::endl;
-            return -1;
-        }
-        out.write(encoded.c_str(), static_cast<std::streamsize>(encoded.size()));
-        out.close();
+    // Odd and rectangular sizes are transformed as they are, no padded copies
+    auto makePlan = [&] {
+        return useFilterBank ? DwtPlan(rows, cols, levels, wavelet, &pool)
+                             : DwtPlan(rows, cols, levels, dwtMethod, &pool);
+    };
 
-        channels_reconstructed.push_back(std::move(reconstructed));
+    // Quantization steps in coding order
+    std::vector<float> steps;
+    for (const auto& [level, band] : order)
+        steps.push_back(qstepFor(level, band));
+
+    // Viewer modes take the bands one after another, so one plan (and its scratch) serves them all:
+    //   --preview: encode, decode and go straight to an 8-bit color image, no metrics
+    //   --quicklook [LEVEL]: reduced-resolution decode, by default from the coarsest LL alone
+    //   --roi ROW COL HEIGHT WIDTH: decode just that window
+    const std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--preview" || mode == "--quicklook" || (mode == "--roi" && argc > 5)) {
+        DwtPlan plan = makePlan();
+        if (!plan.valid()) return -1;
+        if (mode == "--preview")
+            return writePreview(channels, plan, steps, "output/preview_image.png");
+        if (mode == "--quicklook")
+            return writeQuicklook(channels, plan, steps, argc > 2 ? std::atoi(argv[2]) : levels);
+        return decodeRegion(channels, plan, steps, std::atoi(argv[2]), std::atoi(argv[3]),
+                            std::atoi(argv[4]), std::atoi(argv[5]));
     }
 
+    // Bands are independent, so each is one pool task with its own plan; its DWT still spreads
+    // over the pool, and idle workers steal from whichever band has work left
+    std::vector<Plane<float>> channels_reconstructed(channels.size());
+    int status = runBandTasks(pool, static_cast<int>(channels.size()), [&](int c, std::ostream& log) {
+        DwtPlan bandPlan = makePlan();
+        if (!bandPlan.valid()) return -1;
+        return compressChannel(c, channels[c], bandPlan, steps, log, channels_reconstructed[c]);
+    });
+    if (status != 0) return -1;
+
     std::cout << "[6] Saving full color output..." << std::endl;
     if (channels_reconstructed.size() == 3) {
         saveColorImage(channels_reconstructed[0], channels_reconstructed[1], channels_reconstructed[2], outputPath);
@@ -0,0 +1,107 @@
+#include "thread_pool.hpp"
+
+// Pool and deque index of the current thread when it is one of a pool's workers
+static thread_local const ThreadPool* tlsPool = nullptr;
+static thread_local int tlsQueue = 0;
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0)
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (threads <= 0)
+        threads = 1;
+    for (int i = 0; i < threads; ++i)
+        queues_.push_back(std::make_unique<TaskQueue>());
+    for (int i = 1; i < threads; ++i)
+        workers_.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        stop_ = true;
+    }
+    idle_.notify_all();
+    for (auto& t : workers_)
+        t.join();
+}
+
+int ThreadPool::queueIndex() const {
+    return tlsPool == this ? tlsQueue : 0;
+}
+
+// Newest task of our own deque first (its data is still in cache), else the oldest of another's
+bool ThreadPool::popTask(int self, Task& task) {
+    int n = static_cast<int>(queues_.size());
+    for (int k = 0; k < n; ++k) {
+        TaskQueue& q = *queues_[(self + k) % n];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) continue;
+        if (k == 0) {
+            task = q.tasks.back();
+            q.tasks.pop_back();
+        } else {
+            task = q.tasks.front();
+            q.tasks.pop_front();
+        }
+        --queued_;
+        return true;
+    }
+    return false;
+}
+
+// Runs one queued task if there is any; false when every deque was empty
+bool ThreadPool::runOne(int self) {
+    Task task;
+    if (!popTask(self, task)) return false;
+    (*task.fn)(task.index);
+    if (task.remaining->fetch_sub(1) == 1) {
+        // Last task of its parallelFor: wake the caller (the lock orders this after its check)
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        idle_.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::workerLoop(int self) {
+    tlsPool = this;
+    tlsQueue = self;
+    for (;;) {
+        if (runOne(self)) continue;
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        idle_.wait(lock, [&] { return stop_ || queued_ > 0; });
+        if (stop_) return;
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& fn) {
+    if (count <= 0) return;
+    if (workers_.empty() || count == 1) {
+        for (int i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    // Index 0 runs here; the rest go on our deque in reverse, so we pop them in order
+    // while thieves take the far end of the range
+    int self = queueIndex();
+    std::atomic<int> remaining{count - 1};
+    {
+        TaskQueue& q = *queues_[self];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        for (int i = count - 1; i >= 1; --i)
+            q.tasks.push_back(Task{&fn, i, &remaining});
+        queued_ += count - 1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        idle_.notify_all();
+    }
+
+    fn(0);
+    while (remaining > 0) {
+        if (runOne(self)) continue;
+        // Everything left is running on other threads (or was just queued elsewhere)
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        idle_.wait(lock, [&] { return remaining == 0 || queued_ > 0; });
+    }
+}
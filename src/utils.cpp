@@ -3,42 +3,51 @@
 #include <cmath>
 #include <numeric>
 
-std::vector<int> flatten(const std::vector<std::vector<float>>& mat) {
-    std::vector<int> result;
-    for (auto& row : mat)
-        for (auto val : row)
-            result.push_back((int)val);
+std::vector<int> flatten(PlaneView<const float> mat) {
+    std::vector<int> result(static_cast<size_t>(mat.rows()) * mat.cols());
+    size_t idx = 0;
+    for (int i = 0; i < mat.rows(); ++i) {
+        const float* row = mat.row(i);
+        for (int j = 0; j < mat.cols(); ++j)
+            result[idx++] = (int)row[j];
+    }
     return result;
 }
 
-std::vector<std::vector<float>> unflatten(const std::vector<int>& vec, int rows, int cols) {
-    std::vector<std::vector<float>> mat(rows, std::vector<float>(cols));
-    int idx = 0;
-    for (int i = 0; i < rows; ++i)
-        for (int j = 0; j < cols; ++j)
-            mat[i][j] = vec[idx++];
+Plane<float> unflatten(const std::vector<int>& vec, int rows, int cols) {
+    Plane<float> mat(rows, cols);
+    unflatten(vec.data(), mat);
     return mat;
 }
 
-void evaluate(const std::vector<std::vector<float>>& orig, const std::vector<std::vector<float>>& recon) {
+void unflatten(const int* data, PlaneView<float> dst) {
+    size_t idx = 0;
+    for (int i = 0; i < dst.rows(); ++i) {
+        float* row = dst.row(i);
+        for (int j = 0; j < dst.cols(); ++j)
+            row[j] = data[idx++];
+    }
+}
+
+void evaluate(PlaneView<const float> orig, PlaneView<const float> recon, std::ostream& os) {
     double mse = 0;
-    int h = orig.size(), w = orig[0].size();
+    int h = orig.rows(), w = orig.cols();
     for (int i = 0; i < h; ++i)
         for (int j = 0; j < w; ++j)
-            mse += pow(orig[i][j] - recon[i][j], 2);
+            mse += pow(orig(i, j) - recon(i, j), 2);
     mse /= (h * w);
     double psnr = 10 * log10(255 * 255 / mse);
-    std::cout << "MSE: " << mse << "\nPSNR: " << psnr << " dB" << std::endl;
+    os << "MSE: " << mse << "\nPSNR: " << psnr << " dB" << std::endl;
 }
 
-double computeSSIM(const std::vector<std::vector<float>>& img1,
-                   const std::vector<std::vector<float>>& img2) {
-    int h = img1.size(), w = img1[0].size();
+double computeSSIM(PlaneView<const float> img1,
+                   PlaneView<const float> img2) {
+    int h = img1.rows(), w = img1.cols();
     double mu1 = 0, mu2 = 0;
     for (int i = 0; i < h; ++i)
         for (int j = 0; j < w; ++j) {
-            mu1 += img1[i][j];
-            mu2 += img2[i][j];
+            mu1 += img1(i, j);
+            mu2 += img2(i, j);
         }
     mu1 /= (h * w);
     mu2 /= (h * w);
@@ -46,9 +55,9 @@ double computeSSIM(const std::vector<std::vector<float>>& img1,
     double sigma1_sq = 0, sigma2_sq = 0, sigma12 = 0;
     for (int i = 0; i < h; ++i)
         for (int j = 0; j < w; ++j) {
-            sigma1_sq += (img1[i][j] - mu1) * (img1[i][j] - mu1);
-            sigma2_sq += (img2[i][j] - mu2) * (img2[i][j] - mu2);
-            sigma12 += (img1[i][j] - mu1) * (img2[i][j] - mu2);
+            sigma1_sq += (img1(i, j) - mu1) * (img1(i, j) - mu1);
+            sigma2_sq += (img2(i, j) - mu2) * (img2(i, j) - mu2);
+            sigma12 += (img1(i, j) - mu1) * (img2(i, j) - mu2);
         }
     sigma1_sq /= (h * w);
     sigma2_sq /= (h * w);
@@ -62,12 +71,12 @@ double computeSSIM(const std::vector<std::vector<float>>& img1,
 
 // Compute mean Spectral Angle Mapper (SAM) between original and reconstructed images
 double computeMeanSAM(
-    const std::vector<std::vector<std::vector<float>>>& original,
-    const std::vector<std::vector<std::vector<float>>>& reconstructed)
+    const std::vector<Plane<float>>& original,
+    const std::vector<Plane<float>>& reconstructed)
 {
     int bands = original.size();
-    int rows = original[0].size();
-    int cols = original[0][0].size();
+    int rows = original[0].rows();
+    int cols = original[0].cols();
     double sam_sum = 0.0;
     int count = 0;
 
@@ -76,8 +85,8 @@ double computeMeanSAM(
             // Build spectrum vectors for this pixel
             std::vector<float> orig_spec(bands), recon_spec(bands);
             for (int b = 0; b < bands; ++b) {
-                orig_spec[b] = original[b][i][j];
-                recon_spec[b] = reconstructed[b][i][j];
+                orig_spec[b] = original[b](i, j);
+                recon_spec[b] = reconstructed[b](i, j);
             }
             // Compute dot product and norms
             double dot = 0.0, norm_orig = 0.0, norm_recon = 0.0;